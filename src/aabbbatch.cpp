@@ -0,0 +1,100 @@
+#include "aabbbatch.hpp"
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AABB_BATCH_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace CollisionDetection {
+	void AabbArrays::clear() {
+		count = 0;
+		minX.clear();
+		minZ.clear();
+		maxX.clear();
+		maxZ.clear();
+	}
+
+	void AabbArrays::push_back(const BoundingBox& box) {
+		count++;
+		pad();
+		set(count - 1, box);
+	}
+
+	void AabbArrays::set(int i, const BoundingBox& box) {
+		minX[i] = box.lowerCorner.x;
+		minZ[i] = box.lowerCorner.z;
+		maxX[i] = box.upperCorner.x;
+		maxZ[i] = box.upperCorner.z;
+	}
+
+	BoundingBox AabbArrays::get(int i) const {
+		BoundingBox box;
+		box.lowerCorner = {minX[i], 0, minZ[i]};
+		box.upperCorner = {maxX[i], 0, maxZ[i]};
+		return box;
+	}
+
+	void AabbArrays::swapRemove(int i) {
+		count--;
+		minX[i] = minX[count];
+		minZ[i] = minZ[count];
+		maxX[i] = maxX[count];
+		maxZ[i] = maxZ[count];
+		pad();
+	}
+
+	// the padding boxes are inside out, every comparison against them fails
+	void AabbArrays::pad() {
+		size_t padded = (count + AABB_BATCH - 1) / AABB_BATCH * AABB_BATCH;
+		const float inf = std::numeric_limits<float>::infinity();
+		minX.resize(padded);
+		minZ.resize(padded);
+		maxX.resize(padded);
+		maxZ.resize(padded);
+		for (size_t i = count; i < padded; i++) {
+			minX[i] = minZ[i] = inf;
+			maxX[i] = maxZ[i] = -inf;
+		}
+	}
+
+	unsigned overlapMaskScalar(const BoundingBox& box, const AabbArrays& boxes, int first) {
+		unsigned mask = 0;
+		for (int i = 0; i < AABB_BATCH; i++) {
+			int other = first + i;
+			bool overlaps = boxes.minX[other] < box.upperCorner.x && boxes.minZ[other] < box.upperCorner.z &&
+							box.lowerCorner.x < boxes.maxX[other] && box.lowerCorner.z < boxes.maxZ[other];
+			mask |= unsigned(overlaps) << i;
+		}
+		return mask;
+	}
+
+	unsigned overlapMask(const BoundingBox& box, const AabbArrays& boxes, int first) {
+#if defined(__AVX2__)
+		__m256 overlaps = _mm256_and_ps(
+				_mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(&boxes.minX[first]), _mm256_set1_ps(box.upperCorner.x), _CMP_LT_OQ),
+							  _mm256_cmp_ps(_mm256_loadu_ps(&boxes.minZ[first]), _mm256_set1_ps(box.upperCorner.z), _CMP_LT_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(_mm256_set1_ps(box.lowerCorner.x), _mm256_loadu_ps(&boxes.maxX[first]), _CMP_LT_OQ),
+							  _mm256_cmp_ps(_mm256_set1_ps(box.lowerCorner.z), _mm256_loadu_ps(&boxes.maxZ[first]), _CMP_LT_OQ)));
+		return (unsigned) _mm256_movemask_ps(overlaps);
+#elif defined(AABB_BATCH_SSE2)
+		__m128 upperX = _mm_set1_ps(box.upperCorner.x), upperZ = _mm_set1_ps(box.upperCorner.z);
+		__m128 lowerX = _mm_set1_ps(box.lowerCorner.x), lowerZ = _mm_set1_ps(box.lowerCorner.z);
+		unsigned mask = 0;
+		for (int half = 0; half < AABB_BATCH; half += 4) {
+			int other = first + half;
+			__m128 overlaps = _mm_and_ps(
+					_mm_and_ps(_mm_cmplt_ps(_mm_loadu_ps(&boxes.minX[other]), upperX),
+							   _mm_cmplt_ps(_mm_loadu_ps(&boxes.minZ[other]), upperZ)),
+					_mm_and_ps(_mm_cmplt_ps(lowerX, _mm_loadu_ps(&boxes.maxX[other])),
+							   _mm_cmplt_ps(lowerZ, _mm_loadu_ps(&boxes.maxZ[other]))));
+			mask |= unsigned(_mm_movemask_ps(overlaps)) << half;
+		}
+		return mask;
+#else
+		return overlapMaskScalar(box, boxes, first);
+#endif
+	}
+}
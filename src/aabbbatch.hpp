@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include "collisiondetection.hpp"
+
+/*
+Overlap tests of one box against AABB_BATCH boxes at a time. the boxes are kept one array per coordinate, so a batch
+is a single load per coordinate. built for AVX2 when the compiler targets it (USE_AVX2 in cmake), SSE2 otherwise and
+plain loops where neither is there. every version gives the same answers as aabbsOverlap
+*/
+namespace CollisionDetection {
+	const int AABB_BATCH = 8;
+
+	// world space boxes, normalised. padded with boxes nothing overlaps up to a whole number of batches
+	struct AabbArrays {
+		std::vector<float> minX, minZ, maxX, maxZ;
+
+		int size() const {
+			return count;
+		}
+
+		void clear();
+
+		void push_back(const BoundingBox& box);
+
+		void set(int i, const BoundingBox& box);
+
+		BoundingBox get(int i) const;
+
+		// moves the last box to i and drops the last one
+		void swapRemove(int i);
+
+	private:
+		void pad();
+
+		int count = 0;
+	};
+
+	// bit i is set if box overlaps box first + i of boxes, for the AABB_BATCH boxes from first on
+	unsigned overlapMask(const BoundingBox& box, const AabbArrays& boxes, int first);
+
+	// the same without any SIMD, what the other versions are checked against
+	unsigned overlapMaskScalar(const BoundingBox& box, const AabbArrays& boxes, int first);
+}
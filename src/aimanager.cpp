@@ -12,6 +12,7 @@ namespace AI {
 		const int TIMED_SPAWN_THRESHOLD = 20000; //spawn a unit every 20s
 		const int UNSEEN_RADIUS_THRESHOLD = 6;
 		const int FOG_OF_WAR_TIME_THRESHOLD = 10;
+		const float SCOUT_PATH_WEIGHT = 2.5f; //scouts get a path this close to the best one fast, it gets better as they walk
 		int aiManagerRunIterations = 0;
 		int playerUnitValue = 0;
 		int aiUnitValue = 0;
@@ -238,7 +239,10 @@ namespace AI {
 				Coord loc = findBestScoutLocation();
 				std::shared_ptr<Entity> bestUnit = getBestScoutUnit(loc);
 				if (bestUnit) { //if not null
-					bestUnit->moveTo(UnitState::SCOUT, {loc.colCoord, 0, loc.rowCoord});
+					AI::aStar::PathOptions scoutPath = bestUnit->pathOptions;
+					scoutPath.mode = AI::aStar::SearchMode::WEIGHTED; //nobody waits on a scout, the trip is long and rarely contested
+					scoutPath.weight = SCOUT_PATH_WEIGHT;
+					bestUnit->moveToWithPathOptions(UnitState::SCOUT, {loc.colCoord, 0, loc.rowCoord}, scoutPath);
 					Global::scoutingTargetsInProgress.insert(loc);
 				}
 			}
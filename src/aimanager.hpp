@@ -9,6 +9,7 @@
 #include "coord.hpp"
 
 #include <array>
+#include <queue>
 
 //assume AI has goal to destroy main control building of player
 /*we do the tree thing like alla suggested
@@ -5,25 +5,21 @@
 
 #include <ostream> //for overloaded << operator
 #include <cmath> //for round
-#include "model.hpp" //for meshtype
 
-// used to build a graph of nodes for the AI pathfinder to traverse each tile node.
+// a tile node for the AI pathfinder, the search itself only keeps cell indices (see pathfinder.hpp)
 struct AStarNode {
 	int rowCoord, colCoord, movementCost;
 	float fScore;
-	Model::MeshType type;
 
 	AStarNode() = default;
 
 	AStarNode(int _colCoord,
 			  int _rowCoord,
 			  int _movementCost,
-			  float _fScore,
-			  Model::MeshType _type) : rowCoord(_rowCoord),
-									   colCoord(_colCoord),
-									   movementCost(_movementCost),
-									   fScore(_fScore), //don't need to round this since its not part of the == check
-									   type(_type) {}
+			  float _fScore) : rowCoord(_rowCoord),
+							   colCoord(_colCoord),
+							   movementCost(_movementCost),
+							   fScore(_fScore) {} //don't need to round this since its not part of the == check
 
 	bool operator==(const AStarNode& rhs) const {
 		return rowCoord == rhs.rowCoord &&
@@ -0,0 +1,60 @@
+#include <algorithm>
+#include "bucketqueue.hpp"
+
+namespace AI {
+	namespace aStar {
+		const int INITIAL_BUCKETS = 256;
+
+		void BucketQueue::clear() {
+			for (int key = lowestKey; !empty() && key <= highestKey; key++) {
+				std::vector<int>& bucket = buckets[key & mask];
+				count -= (int) bucket.size();
+				bucket.clear();
+			}
+		}
+
+		void BucketQueue::push(int key, int cell) {
+			if (empty()) {
+				lowestKey = highestKey = key;
+				if (buckets.empty()) {
+					grow(INITIAL_BUCKETS);
+				}
+			} else if (key < lowestKey || key > highestKey) {
+				int lowest = std::min(lowestKey, key), highest = std::max(highestKey, key);
+				if (highest - lowest >= (int) buckets.size()) {
+					grow(highest - lowest + 1);
+				}
+				lowestKey = lowest;
+				highestKey = highest;
+			}
+			buckets[key & mask].push_back(cell);
+			count++;
+		}
+
+		int BucketQueue::pop(int& key) {
+			while (buckets[lowestKey & mask].empty()) {
+				lowestKey++;
+			}
+			std::vector<int>& bucket = buckets[lowestKey & mask];
+			int cell = bucket.back();
+			bucket.pop_back();
+			count--;
+			key = lowestKey;
+			return cell;
+		}
+
+		void BucketQueue::grow(int span) {
+			int size = std::max((int) buckets.size(), INITIAL_BUCKETS);
+			while (size < span) {
+				size *= 2;
+			}
+			std::vector<std::vector<int>> grown(size);
+			//everything queued is between the lowest and highest keys, and they all fit in the old buckets
+			for (int key = lowestKey; !empty() && key <= highestKey; key++) {
+				grown[key & (size - 1)].swap(buckets[key & mask]);
+			}
+			buckets.swap(grown);
+			mask = size - 1;
+		}
+	}
+}
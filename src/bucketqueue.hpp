@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+/* priority queue for small integer keys (Dial 1969). every key gets a bucket, so pushing is appending to a vector and
+popping walks up from the lowest key to the first bucket that isn't empty. the buckets wrap around and only have to cover
+the keys that are queued at the same time, which for A* on our costs is a few hundred. they double if a push doesn't fit.
+cells with the same key come out newest first, which has A* carry on down the path it was following*/
+namespace AI {
+	namespace aStar {
+		class BucketQueue {
+		public:
+			bool empty() const {
+				return count == 0;
+			}
+
+			int size() const {
+				return count;
+			}
+
+			void clear();
+
+			void push(int key, int cell);
+
+			// takes out a cell with the lowest key, and sets key to it. the queue must not be empty
+			int pop(int& key);
+
+			// takes out everything and puts it back with the keys given by keyOf(cell)
+			template <typename KeyOf>
+			void rekey(KeyOf keyOf) {
+				std::vector<int> cells;
+				cells.reserve(count);
+				for (int key = lowestKey; !empty() && key <= highestKey; key++) {
+					std::vector<int>& bucket = buckets[key & mask];
+					cells.insert(cells.end(), bucket.begin(), bucket.end());
+					count -= (int) bucket.size();
+					bucket.clear();
+				}
+				for (int cell : cells) {
+					push(keyOf(cell), cell);
+				}
+			}
+
+		private:
+			// makes room for keys spanning at least span values
+			void grow(int span);
+
+			std::vector<std::vector<int>> buckets; //[key & mask], they keep their capacity between searches
+			int mask = -1;
+			int lowestKey = 0; //no queued key is lower than this
+			int highestKey = 0; //or higher than this
+			int count = 0;
+		};
+	}
+}
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <array>
+#include <limits>
 #include <map>
 
 namespace CollisionDetection {
@@ -56,6 +57,32 @@ namespace CollisionDetection {
         return true;
     }
 
+	CollisionInfo sweptAabbCollision(const BoundingBox& a, glm::vec3 aMotion, const BoundingBox& b, glm::vec3 bMotion, float totalTime) {
+		// slabs: on each axis work out the fraction of the motion during which the boxes overlap, they collide if those overlap
+		glm::vec3 motion = aMotion - bMotion; //as if b stood still
+		float enter = -std::numeric_limits<float>::infinity();
+		float exit = std::numeric_limits<float>::infinity();
+		const float aMin[2] = {a.lowerCorner.x, a.lowerCorner.z}, aMax[2] = {a.upperCorner.x, a.upperCorner.z};
+		const float bMin[2] = {b.lowerCorner.x, b.lowerCorner.z}, bMax[2] = {b.upperCorner.x, b.upperCorner.z};
+		const float axisMotion[2] = {motion.x, motion.z};
+		for (int axis = 0; axis < 2; axis++) {
+			if (axisMotion[axis] == 0.0f) {
+				if (bMin[axis] >= aMax[axis] || aMin[axis] >= bMax[axis]) {
+					return {false, 0.0f, {0, 0, 0}};
+				}
+				continue;
+			}
+			float toTouch = (bMin[axis] - aMax[axis]) / axisMotion[axis];
+			float toPart = (bMax[axis] - aMin[axis]) / axisMotion[axis];
+			enter = std::max(enter, std::min(toTouch, toPart));
+			exit = std::min(exit, std::max(toTouch, toPart));
+		}
+		if (enter >= exit || enter >= 1.0f || exit <= 0.0f) {
+			return {false, 0.0f, {0, 0, 0}};
+		}
+		return {true, std::max(enter, 0.0f) * totalTime, {0, 0, 0}};
+	}
+
 	// A static collision check
 	bool aabbsOverlap(MovingBoundingBox a, MovingBoundingBox b) {
 		BoundingBox aBox = a.box;
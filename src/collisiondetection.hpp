@@ -51,6 +51,13 @@ namespace CollisionDetection {
 
 	bool aabbsOverlap(MovingBoundingBox a, MovingBoundingBox b);
 
+	/*
+	Swept test of two world space boxes moving aMotion and bMotion over totalTime. collided if they start to overlap
+	(in the same sense as aabbsOverlap) during it, time is when they first touch. boxes overlapping from the start collide
+	at 0. unlike aabbMinkowskiCollisions it takes where the boxes are into account
+	*/
+	CollisionInfo sweptAabbCollision(const BoundingBox& a, glm::vec3 aMotion, const BoundingBox& b, glm::vec3 bMotion, float totalTime);
+
     BoundingBox normalizeBoundingBox(BoundingBox box);
 
     BoundingBox rotateBoundingBoxAboutOrigin(BoundingBox box);
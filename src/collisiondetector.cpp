@@ -1,85 +1,613 @@
 #include "collisiondetector.hpp"
 #include "collisiondetection.hpp"
 #include "rigidBody.hpp"
+#include <algorithm>
+#include <cmath>
 #include <unordered_map>
 
 #include <map>
 
+int CollisionDetector::bodyOf(int id) const
+{
+	if (id < 0) {
+		return -1;
+	}
+	int slot = id & ((1 << SLOT_BITS) - 1);
+	if (slot >= (int) slots.size() || slots[slot].generation != id >> SLOT_BITS) {
+		return -1;
+	}
+	return slots[slot].body;
+}
+
+int CollisionDetector::idOf(int body) const
+{
+	int slot = bodySlots[body];
+	return slots[slot].generation << SLOT_BITS | slot;
+}
+
+int64_t CollisionDetector::cellOf(int body) const
+{
+	float centreX = (bounds.minX[body] + bounds.maxX[body]) / 2.0f;
+	float centreZ = (bounds.minZ[body] + bounds.maxZ[body]) / 2.0f;
+	return cellKey((int) std::floor(centreX / cellSize), (int) std::floor(centreZ / cellSize));
+}
+
+void CollisionDetector::updateBounds(int body)
+{
+	const CollisionDetection::MovingBoundingBox& box = boxes[body];
+	bounds.set(body, CollisionDetection::normalizeBoundingBox({box.box.lowerCorner + box.position, box.box.upperCorner + box.position}));
+}
+
+int64_t CollisionDetector::cellKey(int col, int row)
+{
+	return int64_t(uint64_t(uint32_t(col)) << 32 | uint32_t(row));
+}
+
+const std::vector<int>* CollisionDetector::cellAround(int64_t cell, int dCol, int dRow) const
+{
+	auto it = cells.find(cellKey(int32_t(uint64_t(cell) >> 32) + dCol, int32_t(uint32_t(cell)) + dRow));
+	return it == cells.end() ? nullptr : &it->second;
+}
+
+void CollisionDetector::insertIntoCell(int body)
+{
+	boxCells[body] = cellOf(body);
+	cells[boxCells[body]].push_back(body);
+}
+
+void CollisionDetector::removeFromCell(int body)
+{
+	std::vector<int>& cell = cells[boxCells[body]];
+	auto it = std::find(cell.begin(), cell.end(), body);
+	*it = cell.back();
+	cell.pop_back();
+}
+
+void CollisionDetector::rebuildGrid(float newCellSize)
+{
+	cellSize = newCellSize;
+	cells.clear();
+	for (size_t body = 0; body < boxes.size(); body++) {
+		insertIntoCell(body);
+	}
+}
+
 
 int CollisionDetector::createBoundingBox(glm::vec3 position, glm::vec3 size, glm::vec3 velocity)
 {
+	finishCollisions();
     CollisionDetection::MovingBoundingBox result;
     result.box.lowerCorner = position - size / 2.0f;
     result.box.upperCorner = position + size / 2.0f;
     result.velocity = velocity;
+	result.position = { 0,0,0 };
 	result.removed = false;
-    int id = boxes.size();
+
+	int slot;
+	if (freeSlots.empty()) {
+		slot = slots.size();
+		slots.emplace_back();
+	} else {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	int body = boxes.size();
+	slots[slot].body = body;
     boxes.push_back(result);
-    collisions.push_back({});
-    return id;
+	contactRanges.emplace_back(0, 0);
+	bodySlots.push_back(slot);
+	boxCells.push_back(0);
+	bounds.push_back({});
+	updateBounds(body);
+	continuous.push_back(false);
+	stillPasses.push_back(0);
+	asleep.push_back(false);
+	moving.push_back(true);
+
+	float width = std::max(std::abs(size.x), std::abs(size.z));
+	if (width > cellSize) {
+		rebuildGrid(width);
+	} else {
+		insertIntoCell(body);
+	}
+    return idOf(body);
+}
+
+CollisionDetector::~CollisionDetector()
+{
+	stopWorkers();
+}
+
+void CollisionDetector::startWorkers(unsigned int workerCount)
+{
+	stopWorkers();
+	if (workerCount == 0) {
+		unsigned int cores = std::thread::hardware_concurrency();
+		workerCount = cores > 1 ? cores - 1 : 0; //leave the main thread a core
+	}
+
+	slices.assign(std::max(workerCount, 1u), Slice());
+	stopping = false;
+	for (unsigned int i = 0; i < workerCount; i++) {
+		workers.emplace_back(&CollisionDetector::workerLoop, this, i, passNumber);
+	}
+}
+
+void CollisionDetector::stopWorkers()
+{
+	finishCollisions();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeWorkers.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+	slices.assign(1, Slice());
+}
+
+void CollisionDetector::workerLoop(int slice, unsigned int donePass)
+{
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeWorkers.wait(lock, [&]() { return stopping || passNumber != donePass; });
+			if (stopping) {
+				return;
+			}
+			donePass = passNumber;
+		}
+		searchSlice(slices[slice]);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			finishedSlices++;
+		}
+		sliceFinished.notify_one();
+	}
 }
 
 void CollisionDetector::findCollisions(float elapsed_ms)
 {
-    // O(n^2) lol
-    for (size_t i = 0; i < boxes.size(); i++) {
-        collisions[i].clear();
-		if (!boxes[i].removed) {
-			for (size_t j = 0; j < boxes.size(); j++) {
-				if (i != j && !boxes[j].removed) {
-					// Detect moving collisions
-					CollisionDetection::CollisionInfo collision = CollisionDetection::aabbMinkowskiCollisions(boxes[i], boxes[j], elapsed_ms);
-					if (collision.collided) {
-						// TODO: Currently only tracks the time of collision, not anything else
-						collision.otherPos = boxes[j].position;
-						glm::vec3 distance = boxes[j].position - boxes[i].position;
-						//collisions[i].push_back(collision);
-					}
+	beginCollisions(elapsed_ms);
+	finishCollisions();
+}
 
-					// Static collisions
-					if (CollisionDetection::aabbsOverlap(boxes[i], boxes[j])) {
-						CollisionDetection::CollisionInfo collision = {
-							true,
-							0.0f,
-							boxes[j].position
-						};
-						collisions[i].push_back(collision);
+void CollisionDetector::beginCollisions(float elapsed_ms)
+{
+	finishCollisions();
+	if (slices.empty()) {
+		slices.emplace_back();
+	}
+	// the runs only depend on the number of workers, each one is about as long as the others
+	int bodyCount = boxes.size();
+	for (size_t i = 0; i < slices.size(); i++) {
+		slices[i].firstBody = int(bodyCount * i / slices.size());
+		slices[i].endBody = int(bodyCount * (i + 1) / slices.size());
+	}
+	updateSleep();
+	passElapsed = elapsed_ms;
+	passRunning = true;
+	if (!workers.empty()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			finishedSlices = 0;
+			passNumber++;
+		}
+		wakeWorkers.notify_all();
+	}
+}
+
+void CollisionDetector::finishCollisions()
+{
+	if (!passRunning) {
+		return;
+	}
+	if (workers.empty()) {
+		searchSlice(slices.front());
+	} else {
+		std::unique_lock<std::mutex> lock(mutex);
+		sliceFinished.wait(lock, [&]() { return finishedSlices == (int) workers.size(); });
+	}
+	passRunning = false;
+	mergeContacts();
+	updateEvents();
+
+	for (const auto& velocity : pendingVelocities) {
+		setVelocity(velocity.first, velocity.second);
+	}
+	pendingVelocities.clear();
+	sweepContinuous();
+}
+
+void CollisionDetector::wake(int body)
+{
+	stillPasses[body] = 0;
+	asleep[body] = false;
+}
+
+void CollisionDetector::updateSleep()
+{
+	for (int body = 0; body < (int) boxes.size(); body++) {
+		moving[body] = boxes[body].velocity != glm::vec3(0, 0, 0) || stillPasses[body] == 0;
+		if (boxes[body].velocity != glm::vec3(0, 0, 0)) {
+			wake(body);
+		} else if (stillPasses[body] < SLEEP_PASSES) {
+			stillPasses[body]++;
+		} else {
+			asleep[body] = true;
+		}
+	}
+}
+
+// in body order, whoever found them. sleeping bodies keep what they touched the pass before if that's asleep too and
+// get what the awake ones found touching them
+void CollisionDetector::mergeContacts()
+{
+	std::swap(contacts, previousContacts);
+	contacts.clear();
+	touchingPairs.clear();
+	wakingContacts.clear();
+	for (const Slice& slice : slices) {
+		for (const auto& contact : slice.contacts) {
+			int other = bodyOf(contact.second.otherId);
+			if (asleep[other]) { //woken below if contact.first is on the move
+				CollisionDetection::CollisionInfo info = {true, 0.0f, boxes[contact.first].position};
+				wakingContacts.emplace_back(other, Contact{idOf(contact.first), info});
+			}
+		}
+	}
+	std::stable_sort(wakingContacts.begin(), wakingContacts.end(), [](const std::pair<int, Contact>& a, const std::pair<int, Contact>& b) {
+		return a.first < b.first;
+	});
+
+	size_t slice = 0, found = 0, waking = 0;
+	auto nextFound = [&]() -> const std::pair<int, Contact>* { //the slices' contacts one after the other
+		while (slice < slices.size() && found == slices[slice].contacts.size()) {
+			slice++;
+			found = 0;
+		}
+		return slice < slices.size() ? &slices[slice].contacts[found] : nullptr;
+	};
+	for (int body = 0; body < (int) boxes.size(); body++) {
+		std::pair<int, int> before = contactRanges[body];
+		contactRanges[body] = {(int) contacts.size(), 0};
+		if (asleep[body]) {
+			for (int i = before.first; i < before.first + before.second; i++) {
+				int other = bodyOf(previousContacts[i].otherId);
+				if (other >= 0 && asleep[other]) {
+					contacts.push_back(previousContacts[i]);
+				}
+			}
+			for (; waking < wakingContacts.size() && wakingContacts[waking].first == body; waking++) {
+				contacts.push_back(wakingContacts[waking].second);
+			}
+		} else {
+			for (const std::pair<int, Contact>* contact; (contact = nextFound()) && contact->first == body; found++) {
+				contacts.push_back(contact->second);
+			}
+		}
+		contactRanges[body].second = (int) contacts.size() - contactRanges[body].first;
+
+		//overlapping is symmetric, the other one has this pair as well
+		int id = idOf(body);
+		for (int i = contactRanges[body].first; i < (int) contacts.size(); i++) {
+			if (id < contacts[i].otherId) {
+				touchingPairs.push_back(uint64_t(id) << 32 | uint32_t(contacts[i].otherId));
+			}
+		}
+	}
+	std::sort(touchingPairs.begin(), touchingPairs.end());
+
+	//bumping into a sleeping box wakes it, leaning on it while standing still doesn't
+	for (const auto& contact : wakingContacts) {
+		if (moving[bodyOf(contact.second.otherId)]) {
+			wake(contact.first);
+		}
+	}
+}
+
+void CollisionDetector::updateEvents()
+{
+	events.clear();
+	auto report = [&](ContactEvent::Type type, uint64_t pair) {
+		events.push_back({type, int(pair >> 32), int(uint32_t(pair))});
+	};
+	size_t now = 0, before = 0;
+	while (now < touchingPairs.size() || before < previousPairs.size()) {
+		if (before == previousPairs.size() || (now < touchingPairs.size() && touchingPairs[now] < previousPairs[before])) {
+			report(ContactEvent::Type::ENTER, touchingPairs[now++]);
+		} else if (now == touchingPairs.size() || previousPairs[before] < touchingPairs[now]) {
+			report(ContactEvent::Type::EXIT, previousPairs[before++]);
+		} else {
+			report(ContactEvent::Type::STAY, touchingPairs[now++]);
+			before++;
+		}
+	}
+	std::swap(touchingPairs, previousPairs); //keeps both buffers
+}
+
+BoundingBox CollisionDetector::sweptBoundsOf(int body) const
+{
+	BoundingBox box = bounds.get(body);
+	glm::vec3 motion = boxes[body].velocity;
+	box.lowerCorner.x += std::min(motion.x, 0.0f);
+	box.lowerCorner.z += std::min(motion.z, 0.0f);
+	box.upperCorner.x += std::max(motion.x, 0.0f);
+	box.upperCorner.z += std::max(motion.z, 0.0f);
+	return box;
+}
+
+// on the main thread after the pass, with the velocities set during it. few boxes opt in
+void CollisionDetector::sweepContinuous()
+{
+	impacts.clear();
+	if (std::find(continuous.begin(), continuous.end(), 1) == continuous.end()) {
+		return;
+	}
+	float furthestMotion = 0; //whatever moves towards a box can't start further away than this
+	for (const CollisionDetection::MovingBoundingBox& box : boxes) {
+		furthestMotion = std::max({furthestMotion, std::abs(box.velocity.x), std::abs(box.velocity.z)});
+	}
+
+	for (int i = 0; i < (int) boxes.size(); i++) {
+		if (!continuous[i]) {
+			continue;
+		}
+		// anything that can get into the swept box has its centre in these cells
+		BoundingBox swept = sweptBoundsOf(i);
+		float reach = furthestMotion + cellSize / 2;
+		int minCol = (int) std::floor((swept.lowerCorner.x - reach) / cellSize);
+		int maxCol = (int) std::floor((swept.upperCorner.x + reach) / cellSize);
+		int minRow = (int) std::floor((swept.lowerCorner.z - reach) / cellSize);
+		int maxRow = (int) std::floor((swept.upperCorner.z + reach) / cellSize);
+		sweptCandidates.clear();
+		if (double(maxCol - minCol + 1) * (maxRow - minRow + 1) > boxes.size()) {
+			for (int j = 0; j < (int) boxes.size(); j++) { //faster than visiting that many cells
+				sweptCandidates.push_back(j);
+			}
+		} else {
+			for (int col = minCol; col <= maxCol; col++) {
+				for (int row = minRow; row <= maxRow; row++) {
+					if (const std::vector<int>* cell = cellAround(cellKey(col, row), 0, 0)) {
+						sweptCandidates.insert(sweptCandidates.end(), cell->begin(), cell->end());
 					}
 				}
 			}
 		}
+
+		// only pairs whose swept bounds meet get the exact test
+		sweptBounds.clear();
+		for (int j : sweptCandidates) {
+			sweptBounds.push_back(sweptBoundsOf(j));
+		}
+		BoundingBox box = bounds.get(i);
+		for (int first = 0; first < sweptBounds.size(); first += CollisionDetection::AABB_BATCH) {
+			unsigned canMeet = CollisionDetection::overlapMask(swept, sweptBounds, first);
+			for (int k = 0; canMeet != 0; k++, canMeet >>= 1) {
+				int j = sweptCandidates[first + k];
+				if (!(canMeet & 1) || j == i || CollisionDetection::aabbsOverlap(box, bounds.get(j))) {
+					continue; //touching already, that's a contact
+				}
+				CollisionDetection::CollisionInfo impact = CollisionDetection::sweptAabbCollision(
+						box, boxes[i].velocity, bounds.get(j), boxes[j].velocity, passElapsed);
+				if (impact.collided) {
+					impact.otherPos = boxes[j].position;
+					impacts.push_back({idOf(i), idOf(j), impact});
+				}
+			}
+		}
+	}
+	std::sort(impacts.begin(), impacts.end(), [](const Impact& a, const Impact& b) {
+		return a.info.time < b.info.time || (a.info.time == b.info.time &&
+				(a.id < b.id || (a.id == b.id && a.otherId < b.otherId)));
+	});
+}
+
+void CollisionDetector::searchSlice(Slice& slice)
+{
+	slice.contacts.clear();
+	std::vector<int>& candidates = slice.candidates;
+	CollisionDetection::AabbArrays& candidateBounds = slice.candidateBounds;
+    for (int i = slice.firstBody; i < slice.endBody; i++) {
+		// only the boxes around this one can touch it, in body order so the results don't depend on the hash map
+		candidates.clear();
+		if (asleep[i]) {
+			continue; //whoever is awake around it reports it
+		}
+		for (int dCol = -1; dCol <= 1; dCol++) {
+			for (int dRow = -1; dRow <= 1; dRow++) {
+				if (const std::vector<int>* cell = cellAround(boxCells[i], dCol, dRow)) {
+					candidates.insert(candidates.end(), cell->begin(), cell->end());
+				}
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::find(candidates.begin(), candidates.end(), i));
+
+		// moving collisions are only worked out for boxes that asked for them, see sweepContinuous
+		candidateBounds.clear();
+		for (int j : candidates) {
+			candidateBounds.push_back(bounds.get(j));
+		}
+
+		// Static collisions
+		BoundingBox box = bounds.get(i);
+		for (int first = 0; first < candidateBounds.size(); first += CollisionDetection::AABB_BATCH) {
+			unsigned overlaps = CollisionDetection::overlapMask(box, candidateBounds, first);
+			for (int k = 0; overlaps != 0; k++, overlaps >>= 1) {
+				if (overlaps & 1) {
+					int j = candidates[first + k];
+					CollisionDetection::CollisionInfo collision = {
+						true,
+						0.0f,
+						boxes[j].position
+					};
+					slice.contacts.emplace_back(i, Contact{idOf(j), collision});
+				}
+			}
+		}
     }
-	return;
+}
+
+int CollisionDetector::countCandidates(int id) const
+{
+	int body = bodyOf(id);
+	if (body < 0) {
+		return 0;
+	}
+	int count = -1; //not counting itself
+	for (int dCol = -1; dCol <= 1; dCol++) {
+		for (int dRow = -1; dRow <= 1; dRow++) {
+			if (const std::vector<int>* cell = cellAround(boxCells[body], dCol, dRow)) {
+				count += (int) cell->size();
+			}
+		}
+	}
+	return count;
 }
 
 std::vector<CollisionDetection::CollisionInfo> CollisionDetector::getAllCollisions(int id)
 {
-    return collisions[id];
+	std::vector<CollisionDetection::CollisionInfo> result;
+	forEachContact(id, [&](const Contact& contact) {
+		result.push_back(contact.info);
+	});
+    return result;
 }
 
 CollisionDetection::CollisionInfo CollisionDetector::getFirstCollision(int id)
 {
     CollisionDetection::CollisionInfo firstCollision;
     firstCollision.collided = false;
-    for (size_t i = 0; i < collisions[id].size(); i++) {
-        if (!firstCollision.collided || (collisions[id][i].collided && collisions[id][i].time < firstCollision.time)) {
-            firstCollision = collisions[id][i];
+	forEachContact(id, [&](const Contact& contact) {
+        if (!firstCollision.collided || (contact.info.collided && contact.info.time < firstCollision.time)) {
+            firstCollision = contact.info;
         }
-    }
+	});
     return firstCollision;
 }
 
+bool CollisionDetector::hasContact(int id)
+{
+	finishCollisions();
+	int body = bodyOf(id);
+	return body >= 0 && contactRanges[body].second > 0;
+}
+
+const std::vector<CollisionDetector::Impact>& CollisionDetector::getImpacts()
+{
+	finishCollisions();
+	return impacts;
+}
+
+CollisionDetection::CollisionInfo CollisionDetector::getFirstImpact(int id)
+{
+	finishCollisions();
+	for (const Impact& impact : impacts) {
+		if (impact.id == id) {
+			return impact.info;
+		}
+	}
+	return {false, 0.0f, {0, 0, 0}};
+}
+
+void CollisionDetector::setContinuous(int id, bool enabled)
+{
+	finishCollisions();
+	int body = bodyOf(id);
+	if (body >= 0) {
+		continuous[body] = enabled;
+	}
+}
+
+const std::vector<CollisionDetector::ContactEvent>& CollisionDetector::contactEvents()
+{
+	finishCollisions();
+	return events;
+}
+
 void CollisionDetector::setVelocity(int id, glm::vec3 velocity)
 {
-    boxes[id].velocity = velocity;
+	if (passRunning) {
+		pendingVelocities.emplace_back(id, velocity); //the workers are reading them
+		return;
+	}
+	int body = bodyOf(id);
+	if (body >= 0 && boxes[body].velocity != velocity) {
+		boxes[body].velocity = velocity;
+		wake(body);
+	}
 }
 
 void CollisionDetector::setPosition(int id, glm::vec3 position)
 {
-    boxes[id].position = position;
+	finishCollisions();
+	int body = bodyOf(id);
+	if (body < 0 || boxes[body].position == position) {
+		return;
+	}
+	wake(body);
+    boxes[body].position = position;
+	updateBounds(body);
+	if (cellOf(body) != boxCells[body]) {
+		removeFromCell(body);
+		insertIntoCell(body);
+	}
 }
 
 void CollisionDetector::remove(int id)
 {
-	boxes[id].removed = true;
+	finishCollisions();
+	int body = bodyOf(id);
+	if (body < 0) {
+		return;
+	}
+	removeFromCell(body);
+	int slot = bodySlots[body];
+	slots[slot].body = -1;
+	slots[slot].generation = (slots[slot].generation + 1) & GENERATION_MASK;
+	freeSlots.push_back(slot);
+
+	// keep the live boxes packed, the last one takes this one's place
+	int last = (int) boxes.size() - 1;
+	if (body != last) {
+		std::vector<int>& cell = cells[boxCells[last]];
+		*std::find(cell.begin(), cell.end(), last) = body;
+		boxes[body] = boxes[last];
+		contactRanges[body] = contactRanges[last];
+		continuous[body] = continuous[last];
+		stillPasses[body] = stillPasses[last];
+		asleep[body] = asleep[last];
+		moving[body] = moving[last];
+		bodySlots[body] = bodySlots[last];
+		boxCells[body] = boxCells[last];
+		slots[bodySlots[body]].body = body;
+	}
+	bounds.swapRemove(body);
+	boxes.pop_back();
+	contactRanges.pop_back();
+	continuous.pop_back();
+	stillPasses.pop_back();
+	asleep.pop_back();
+	moving.pop_back();
+	bodySlots.pop_back();
+	boxCells.pop_back();
+}
+
+bool CollisionDetector::isAlive(int id) const
+{
+	return bodyOf(id) >= 0;
+}
+
+int CollisionDetector::size() const
+{
+	return boxes.size();
+}
+
+bool CollisionDetector::isAsleep(int id) const
+{
+	int body = bodyOf(id);
+	return body >= 0 && asleep[body];
 }
@@ -1,13 +1,152 @@
 #pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include "common.hpp"
 #include "rigidBody.hpp"
+#include "aabbbatch.hpp"
 #include "collisiondetection.hpp"
 
+/*
+Broadphase: every box sits in the cell of a uniform grid its centre is in. cells are at least as wide as the widest box,
+so boxes that overlap are always in the same or neighbouring cells and only those pairs reach the narrowphase.
+boxes change cells in setPosition, nothing is rebuilt per frame. the narrowphase overlap test runs on batches of
+candidates at a time, see aabbbatch.hpp
+
+Storage: live boxes are packed at the front of boxes (their "body" index), removing one moves the last box into its place.
+IDs handed out are a slot and the slot's generation, the slot says where the box is now. removed slots get reused by
+the next box created with their generation bumped, so an ID kept after its box was removed is just ignored
+
+Threads: a collision pass is split into runs of bodies, one per worker. each worker writes what it finds into its own
+buffer and the buffers are merged in body order, so the results are the same for any number of workers
+
+Contacts: the pairs touching after a pass are kept and compared with the ones from the pass before, which gives the
+enter, stay and exit events. a box's contacts sit next to each other in one array that is reused every pass, asking
+about them doesn't copy or allocate anything
+
+Continuous collision: boxes that opt in with setContinuous are also swept along their velocity (how far they move over
+the tick) against everything whose swept bounds meet theirs, once the velocities for the tick are all set. that gives
+the time they would hit something, which overlap tests miss for anything fast enough to jump over a box in one tick
+
+Sleeping: a box that has stood still with no velocity for SLEEP_PASSES passes falls asleep and stops looking for what
+it touches, the boxes still awake around it find it instead. its contacts with other sleeping boxes can't have changed
+and are kept from the pass before. moving it, changing its velocity or a moving box touching it wakes it up. awake
+boxes that are standing still themselves leave it asleep, they are only waiting for their own turn to sleep
+*/
 class CollisionDetector {
+public:
+	struct Contact {
+		int otherId;
+		CollisionDetection::CollisionInfo info;
+	};
+
+	struct ContactEvent {
+		enum class Type {
+			ENTER, //touching now, weren't after the pass before
+			STAY,
+			EXIT, //not touching any more, or one of them was removed
+		};
+		Type type;
+		int id, otherId; //id < otherId, every pair is only reported once
+	};
+
+	struct Impact {
+		int id, otherId; //id is the one with continuous collision
+		CollisionDetection::CollisionInfo info; //info.time is in ms into the tick
+	};
+
+private:
+	static const int SLOT_BITS = 20; //a million boxes at the same time
+	static const int GENERATION_MASK = (1 << (31 - SLOT_BITS)) - 1; //generations wrap, ids stay positive
+	static const int SLEEP_PASSES = 30; //half a second at 60 fps
+
+	struct Slot {
+		int generation = 0;
+		int body = -1; //-1 while free
+	};
+
+	std::vector<Slot> slots;
+	std::vector<int> freeSlots;
+
+	// per body, packed
     std::vector<CollisionDetection::MovingBoundingBox> boxes;
-    std::vector<std::vector<CollisionDetection::CollisionInfo>> collisions;
-    
+	std::vector<std::pair<int, int>> contactRanges; //first and count in contacts
+	std::vector<int> bodySlots;
+	std::vector<int64_t> boxCells; //the key of the cell it's in
+	CollisionDetection::AabbArrays bounds; //where the box is in the world
+	std::vector<uint8_t> continuous; //swept as well, see setContinuous
+	std::vector<int> stillPasses; //passes since it last moved
+	std::vector<uint8_t> asleep; //only changes between passes
+	std::vector<uint8_t> moving; //has a velocity or was moved since the pass before, as of this pass
+
+	float cellSize = 1.0f; //unit footprint, grows to fit the widest box created
+	std::unordered_map<int64_t, std::vector<int>> cells; //cell key -> bodies in it
+
+	std::vector<Contact> contacts, previousContacts; //from the last pass, grouped by body
+	std::vector<std::pair<int, Contact>> wakingContacts; //sleeping body, the awake one that found it
+	std::vector<uint64_t> touchingPairs, previousPairs; //sorted, smaller id in the high half
+	std::vector<ContactEvent> events;
+	std::vector<Impact> impacts; //soonest first
+	std::vector<int> sweptCandidates;
+	CollisionDetection::AabbArrays sweptBounds; //of sweptCandidates, in the same order
+
+	// one worker's share of a collision pass
+	struct Slice {
+		int firstBody = 0, endBody = 0;
+		std::vector<int> candidates;
+		CollisionDetection::AabbArrays candidateBounds; //bounds of the candidates, in the same order
+		std::vector<std::pair<int, Contact>> contacts; //body, what it ran into
+	};
+	std::vector<Slice> slices; //one per worker, just the one without workers
+	std::vector<std::thread> workers;
+	std::mutex mutex; //guards passNumber, finishedSlices and stopping
+	std::condition_variable wakeWorkers, sliceFinished;
+	unsigned int passNumber = 0;
+	int finishedSlices = 0;
+	bool stopping = false;
+
+	//main thread only
+	bool passRunning = false;
+	float passElapsed = 0;
+	std::vector<std::pair<int, glm::vec3>> pendingVelocities; //id, velocity set while a pass was running
+
+	void searchSlice(Slice& slice); //fills slice.contacts for its bodies, only reads everything else
+	void workerLoop(int slice, unsigned int donePass);
+
+	// the body id refers to, -1 if it was removed (or never was a box)
+	int bodyOf(int id) const;
+	int idOf(int body) const;
+
+	void wake(int body);
+	void updateSleep(); //at the start of a pass
+	void mergeContacts();
+	void updateEvents();
+	BoundingBox sweptBoundsOf(int body) const; //the box and where it will be at the end of the tick
+	void sweepContinuous();
+
+	static int64_t cellKey(int col, int row);
+	int64_t cellOf(int body) const;
+	void updateBounds(int body);
+	const std::vector<int>* cellAround(int64_t cell, int dCol, int dRow) const; //nullptr if nothing was ever in it
+	void insertIntoCell(int body);
+	void removeFromCell(int body);
+	void rebuildGrid(float newCellSize);
+
 public:
+	static const int NO_BOX = -1; //an ID that never refers to a box, see RigidBody::WithoutGeometry
+
+	CollisionDetector() = default;
+	CollisionDetector(const CollisionDetector&) = delete;
+	~CollisionDetector();
+
+	// starts the threads collision passes run on, 0 picks one less than the number of cores (so none on a single core).
+	// without workers passes run on the main thread in finishCollisions
+	void startWorkers(unsigned int workerCount = 0);
+
+	void stopWorkers();
+
     /*
     Creates a collision geometry of type type and adds it to the list of stuff to check collisions for.
     Returns the ID of the box;
@@ -19,14 +158,52 @@ public:
     */
     void findCollisions(float elapsed_ms);
 
+	/* findCollisions in two halves, so the main thread can get on with something else while the workers search.
+	until finishCollisions anything that moves, creates or removes a box or asks for collisions waits for the pass
+	to finish first. velocities set in between are applied once it has*/
+	void beginCollisions(float elapsed_ms);
+	void finishCollisions();
+
+	// nothing for IDs of removed boxes
     std::vector<CollisionDetection::CollisionInfo> getAllCollisions(int id);
     CollisionDetection::CollisionInfo getFirstCollision(int id);
 
-    void setVelocity(int id, glm::vec3 velocity);
-    void setPosition(int id, glm::vec3 position);
+	// the same without copying anything
+	bool hasContact(int id);
 
-	// Todo: Currently just a soft delete - cant rearrange everything without invalidating IDs
+	template <typename Visit>
+	void forEachContact(int id, Visit visit) {
+		finishCollisions();
+		int body = bodyOf(id);
+		for (int i = 0; body >= 0 && i < contactRanges[body].second; i++) {
+			visit(contacts[contactRanges[body].first + i]);
+		}
+	}
+
+	// what changed between the last two passes, in id order
+	const std::vector<ContactEvent>& contactEvents();
+
+	// what the last pass found the boxes with continuous collision would hit, soonest first
+	const std::vector<Impact>& getImpacts();
+
+	// the soonest one of id's, collided is false if it isn't going to hit anything this tick
+	CollisionDetection::CollisionInfo getFirstImpact(int id);
+
+	// these do nothing for IDs of removed boxes
+	void setContinuous(int id, bool enabled);
+    void setVelocity(int id, glm::vec3 velocity); //how far the box moves over the tick
+    void setPosition(int id, glm::vec3 position);
 	void remove(int id);
 
+	bool isAlive(int id) const;
+
+	bool isAsleep(int id) const;
+
+	// boxes that haven't been removed
+	int size() const;
+
+	// how many boxes are in the cells around id's, ie how many the narrowphase will look at for it
+	int countCandidates(int id) const;
+
     // TODO add methods to scale and rotate
 };
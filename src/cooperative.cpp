@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cmath>
+#include "cooperative.hpp"
+#include "pathfinder.hpp" //for movement costs and neighbours
+
+namespace AI {
+	namespace cooperative {
+		ReservationTable reservations;
+
+		void ReservationTable::advance(double elapsed_ms) {
+			stepElapsed += elapsed_ms;
+			while (stepElapsed >= STEP_MS) {
+				stepElapsed -= STEP_MS;
+				if (!expiring.empty()) {
+					for (uint64_t reservation : expiring.front()) {
+						reservations.erase(reservation);
+					}
+					expiring.pop_front();
+				}
+				step++;
+			}
+		}
+
+		bool ReservationTable::isFree(int cell, int step, const void* owner) const {
+			auto it = reservations.find(key(cell, step));
+			return it == reservations.end() || it->second == owner;
+		}
+
+		void ReservationTable::reserve(int cell, int firstStep, int lastStep, const void* owner) {
+			for (int reserved = std::max(firstStep, step); reserved <= lastStep; reserved++) {
+				uint64_t reservation = key(cell, reserved);
+				if (!reservations.emplace(reservation, owner).second) {
+					continue; //taken already, whoever got there first keeps it
+				}
+				held[owner].push_back(reservation);
+				if ((int) expiring.size() <= reserved - step) {
+					expiring.resize(reserved - step + 1);
+				}
+				expiring[reserved - step].push_back(reservation);
+			}
+		}
+
+		void ReservationTable::reservePlan(int startCell, int startStep, const std::vector<Arrival>& arrivals,
+										   const void* owner) {
+			int cell = startCell, from = startStep;
+			for (const Arrival& arrival : arrivals) {
+				reserve(cell, from, arrival.step, owner);
+				reserve(arrival.cell, from + 1, arrival.step, owner);
+				cell = arrival.cell;
+				from = arrival.step;
+			}
+			reserve(cell, from, from + WINDOW_STEPS, owner); //still standing there when the next plan is made
+		}
+
+		void ReservationTable::release(const void* owner) {
+			auto it = held.find(owner);
+			if (it == held.end()) {
+				return;
+			}
+			for (uint64_t reservation : it->second) {
+				auto found = reservations.find(reservation);
+				if (found != reservations.end() && found->second == owner) {
+					reservations.erase(found);
+				}
+			}
+			held.erase(it);
+		}
+
+		void ReservationTable::clear() {
+			step = 0;
+			stepElapsed = 0;
+			reservations.clear();
+			held.clear();
+			expiring.clear();
+		}
+
+		int straightSteps(int movementSpeed) {
+			return std::max(1, (int) std::lround(1000.0 / (std::max(movementSpeed, 1) * STEP_MS)));
+		}
+
+		int diagonalSteps(int movementSpeed) {
+			return std::max(1, (int) std::lround(1414.0 / (std::max(movementSpeed, 1) * STEP_MS)));
+		}
+
+		struct Node {
+			int cell;
+			int step;
+			int gScore;
+			int parent; //index into nodes, -1 for the start
+		};
+
+		bool plan(const NavGrid::Grid& grid, const ReservationTable& table, const landmarks::Landmarks& landmarks,
+				  int startCell, int startStep, int goalCell, int movementSpeed, const void* owner,
+				  std::vector<Arrival>& arrivals) {
+			arrivals.clear();
+			thread_local std::vector<Node> nodes;
+			thread_local std::vector<aStar::FrontierNode> frontier; //cell is the index into nodes here
+			thread_local std::unordered_map<uint64_t, int> bestGScores; //per (cell, step)
+			nodes.clear();
+			frontier.clear();
+			bestGScores.clear();
+
+			landmarks::Estimate estimate(grid, landmarks, goalCell);
+			int straight = straightSteps(movementSpeed), diagonal = diagonalSteps(movementSpeed);
+			int waitCost = std::max(1, aStar::STRAIGHT_MOVEMENT_COST / straight); //standing still is as slow as walking
+			int windowEnd = startStep + WINDOW_STEPS;
+
+			auto relax = [&](int cell, int step, int gScore, int parent) {
+				uint64_t state = (uint64_t(uint32_t(step)) << 32) | uint32_t(cell);
+				auto it = bestGScores.find(state);
+				if (it != bestGScores.end() && it->second <= gScore) {
+					return;
+				}
+				bestGScores[state] = gScore;
+				nodes.push_back({cell, step, gScore, parent});
+				frontier.push_back({float(gScore + estimate(cell)), (int) nodes.size() - 1});
+				std::push_heap(frontier.begin(), frontier.end(), aStar::aStarComparator());
+			};
+			//the cell has to stay free for every step of a move, for the cell being left as well as the one stepped onto
+			auto staysFree = [&](int cell, int fromStep, int toStep) {
+				for (int step = fromStep; step <= toStep; step++) {
+					if (!table.isFree(cell, step, owner)) {
+						return false;
+					}
+				}
+				return true;
+			};
+
+			relax(startCell, startStep, 0, -1);
+			aStar::NeighborBuffer neighbors;
+			int expansions = 0;
+			while (!frontier.empty() && expansions < MAX_EXPANSIONS) {
+				std::pop_heap(frontier.begin(), frontier.end(), aStar::aStarComparator());
+				int current = frontier.back().cell;
+				frontier.pop_back();
+				Node node = nodes[current];
+
+				if (node.cell == goalCell || node.step >= windowEnd) {
+					for (int at = current; nodes[at].parent >= 0; at = nodes[at].parent) {
+						arrivals.push_back({nodes[at].cell, nodes[at].step});
+					}
+					std::reverse(arrivals.begin(), arrivals.end());
+					return true;
+				}
+				// a cheaper way to the same cell at the same step was pushed after this one
+				if (bestGScores[(uint64_t(uint32_t(node.step)) << 32) | uint32_t(node.cell)] < node.gScore) {
+					continue;
+				}
+				expansions++;
+
+				if (table.isFree(node.cell, node.step + 1, owner)) {
+					relax(node.cell, node.step + 1, node.gScore + waitCost, current);
+				}
+				aStar::getNeighbors(grid, node.cell, goalCell, neighbors);
+				for (const aStar::Neighbor& next : neighbors) {
+					bool isDiagonal = grid.colOf(next.cell) != grid.colOf(node.cell) &&
+									  grid.rowOf(next.cell) != grid.rowOf(node.cell);
+					int arrival = node.step + (isDiagonal ? diagonal : straight);
+					if (staysFree(next.cell, node.step + 1, arrival) && staysFree(node.cell, node.step + 1, arrival)) {
+						relax(next.cell, arrival, node.gScore + next.movementCost, current);
+					}
+				}
+			}
+			return false;
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include "navgrid.hpp"
+#include "landmarks.hpp"
+
+/* windowed cooperative A* (WHCA*, Silver 2005). units plan a few steps ahead in space and time and write down which cell
+they will be in at every step, later units plan around those reservations instead of walking into each other and
+bouncing off. only the next WINDOW_STEPS steps are planned, past that the unit just needs to be heading the right way,
+so a plan is cheap and gets redone every half window as the unit walks*/
+namespace AI {
+	namespace cooperative {
+		const int STEP_MS = 100; //length of one step of the reservation table
+		const int WINDOW_STEPS = 16;
+		const int MAX_EXPANSIONS = 4096; //a unit boxed in by reservations gives up rather than searching forever
+
+		// where a unit gets to at which step, a wait shows up as the same cell again one step later
+		struct Arrival {
+			int cell;
+			int step;
+		};
+
+		// which cells are taken by whom at which step, steps count up from when the level was loaded
+		class ReservationTable {
+		public:
+			// moves the clock on, reservations that are in the past are dropped
+			void advance(double elapsed_ms);
+
+			int currentStep() const {
+				return step;
+			}
+
+			// true if nobody but owner holds cell at step
+			bool isFree(int cell, int step, const void* owner) const;
+
+			void reserve(int cell, int firstStep, int lastStep, const void* owner);
+
+			/* reserves what walking arrivals takes, starting on startCell at arrivals.front().step. both ends of a move are
+			held until it's done so two units never swap cells, the last cell is held to the end of the next window*/
+			void reservePlan(int startCell, int startStep, const std::vector<Arrival>& arrivals, const void* owner);
+
+			// drops everything owner holds
+			void release(const void* owner);
+
+			int reservationCount() const {
+				return (int) reservations.size();
+			}
+
+			void clear();
+
+		private:
+			static uint64_t key(int cell, int step) {
+				return (uint64_t(uint32_t(step)) << 32) | uint32_t(cell);
+			}
+
+			int step = 0;
+			double stepElapsed = 0;
+			std::unordered_map<uint64_t, const void*> reservations;
+			std::unordered_map<const void*, std::vector<uint64_t>> held; //what each owner reserved, for release
+			std::deque<std::vector<uint64_t>> expiring; //[step - this->step], what to drop when the clock passes it
+		};
+
+		// how many steps moves take for a unit moving movementSpeed cells per second, never less than one
+		int straightSteps(int movementSpeed);
+
+		int diagonalSteps(int movementSpeed);
+
+		/* space-time A* from startCell at startStep towards goalCell, for the window after startStep. moves are the same as
+		for the other searches, with waiting in place as one more move. arrivals gets every move or wait in order, the
+		first one after startCell. it ends on the goal or at the end of the window, whichever comes first.
+		returns false if the unit can't get anywhere without running into reservations*/
+		bool plan(const NavGrid::Grid& grid, const ReservationTable& table, const landmarks::Landmarks& landmarks,
+				  int startCell, int startStep, int goalCell, int movementSpeed, const void* owner,
+				  std::vector<Arrival>& arrivals);
+
+		extern ReservationTable reservations;
+	}
+}
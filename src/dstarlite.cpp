@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include "dstarlite.hpp"
+
+namespace AI {
+	namespace dStarLite {
+		const int INFINITE_COST = std::numeric_limits<int>::max();
+
+		// the 8 moves, straight ones first so ties on the way back out prefer them
+		const auto& moves = NavGrid::neighborDirections;
+
+		struct keyComparator {
+			template<typename Entry>
+			bool operator()(const Entry& a, const Entry& b) const {
+				return b.key < a.key; //min heap
+			}
+		};
+
+		void Planner::reset() {
+			goalCell = -1;
+			startCell = -1;
+			keyModifier = 0;
+			states.clear();
+			queue.clear();
+		}
+
+		Planner::State Planner::getState(int cell) const {
+			auto it = states.find(cell);
+			if (it == states.end()) {
+				return {INFINITE_COST, INFINITE_COST};
+			}
+			return it->second;
+		}
+
+		Planner::Key Planner::calculateKey(const NavGrid::Grid& grid, int cell, const State& state) const {
+			int cost = std::min(state.g, state.rhs);
+			if (cost == INFINITE_COST) {
+				return {INFINITE_COST, INFINITE_COST};
+			}
+			return {cost + aStar::octileDistance(grid, startCell, cell) + keyModifier, cost};
+		}
+
+		bool Planner::isOpen(const NavGrid::Grid& grid, int col, int row) const {
+			if (!grid.withinBounds(col, row)) {
+				return false;
+			}
+			int cell = grid.index(col, row);
+			return cell == goalCell || !grid.isObstacle(cell);
+		}
+
+		int Planner::stepCost(const NavGrid::Grid& grid, int cell, int direction) const {
+			int col = grid.colOf(cell), row = grid.rowOf(cell);
+			bool straight = direction < 4;
+			//the masks know which moves are open, unless the goal is an obstacle right next to us: it counts as open
+			bool goalNextToUs = goalIsObstacle && std::abs(grid.colOf(goalCell) - col) <= 1 &&
+								std::abs(grid.rowOf(goalCell) - row) <= 1;
+			if (!goalNextToUs) {
+				if (!grid.canStep(cell, direction)) {
+					return INFINITE_COST;
+				}
+				return grid.costs[cell + grid.stepOffset(direction)] +
+					   (straight ? aStar::STRAIGHT_MOVEMENT_COST : aStar::DIAGONAL_MOVEMENT_COST);
+			}
+
+			int nextCol = col + moves[direction].first, nextRow = row + moves[direction].second;
+			if (!isOpen(grid, nextCol, nextRow)) {
+				return INFINITE_COST;
+			}
+			int next = grid.index(nextCol, nextRow);
+			if (straight) {
+				return grid.costs[next] + aStar::STRAIGHT_MOVEMENT_COST;
+			}
+			//dont go thru diagonal corners
+			if (!isOpen(grid, nextCol, row) || !isOpen(grid, col, nextRow)) {
+				return INFINITE_COST;
+			}
+			return grid.costs[next] + aStar::DIAGONAL_MOVEMENT_COST;
+		}
+
+		void Planner::push(const Key& key, int cell) {
+			queue.push_back({key, cell});
+			std::push_heap(queue.begin(), queue.end(), keyComparator());
+		}
+
+		// recomputes the lookahead of cell from its neighbours and queues it if that disagrees with its cost
+		void Planner::updateVertex(const NavGrid::Grid& grid, int cell) {
+			State state = getState(cell);
+			if (cell != goalCell) {
+				state.rhs = INFINITE_COST;
+				for (int i = 0; i < (int) moves.size(); i++) {
+					int cost = stepCost(grid, cell, i);
+					if (cost == INFINITE_COST) {
+						continue;
+					}
+					int g = getState(cell + grid.stepOffset(i)).g;
+					if (g != INFINITE_COST) {
+						state.rhs = std::min(state.rhs, g + cost);
+					}
+				}
+			}
+
+			if (state.g == INFINITE_COST && state.rhs == INFINITE_COST) {
+				states.erase(cell); //keep the map down to cells that can reach the goal
+				return;
+			}
+			states[cell] = state;
+			if (state.g != state.rhs) {
+				push(calculateKey(grid, cell, state), cell);
+			}
+		}
+
+		void Planner::computeShortestPath(const NavGrid::Grid& grid) {
+			while (!queue.empty()) {
+				QueueEntry top = queue.front();
+				State state = getState(top.cell);
+				Key key = calculateKey(grid, top.cell, state);
+				if (state.g == state.rhs || key < top.key) {
+					//consistent already, or a cheaper entry for the cell was queued after this one
+					std::pop_heap(queue.begin(), queue.end(), keyComparator());
+					queue.pop_back();
+					continue;
+				}
+
+				State start = getState(startCell);
+				if (!(top.key < calculateKey(grid, startCell, start)) && start.rhs <= start.g) {
+					return; //nothing left in the queue can change the cost from the start
+				}
+
+				std::pop_heap(queue.begin(), queue.end(), keyComparator());
+				queue.pop_back();
+				if (top.key < key) { //queued before the unit moved on, look at it again with its current key
+					push(key, top.cell);
+					continue;
+				}
+
+				expansions++;
+				int col = grid.colOf(top.cell), row = grid.rowOf(top.cell);
+				if (state.g > state.rhs) {
+					state.g = state.rhs;
+					states[top.cell] = state;
+					//every neighbour that can step onto this cell might now be cheaper through it
+					//the neighbour's own mask, the start can be on an obstacle and still step off it
+					for (int i = 0; i < (int) moves.size(); i++) {
+						if (!grid.withinBounds(col - moves[i].first, row - moves[i].second)) {
+							continue;
+						}
+						int from = top.cell - grid.stepOffset(i);
+						int cost = stepCost(grid, from, i);
+						if (from == goalCell || cost == INFINITE_COST) {
+							continue;
+						}
+						State fromState = getState(from);
+						if (state.g + cost < fromState.rhs) {
+							fromState.rhs = state.g + cost;
+							states[from] = fromState;
+							if (fromState.g != fromState.rhs) {
+								push(calculateKey(grid, from, fromState), from);
+							}
+						}
+					}
+				} else {
+					//got more expensive, everything that went through this cell has to look for another way
+					state.g = INFINITE_COST;
+					states[top.cell] = state;
+					updateVertex(grid, top.cell);
+					for (const auto& move : moves) {
+						int fromCol = col - move.first, fromRow = row - move.second;
+						if (grid.withinBounds(fromCol, fromRow)) {
+							updateVertex(grid, grid.index(fromCol, fromRow));
+						}
+					}
+				}
+			}
+		}
+
+		void Planner::restart(const NavGrid::Grid& grid, int start, int goal) {
+			reset();
+			startCell = start;
+			goalCell = goal;
+			width = grid.width;
+			height = grid.height;
+			states[goalCell] = {INFINITE_COST, 0};
+			push(calculateKey(grid, goalCell, states[goalCell]), goalCell);
+		}
+
+		bool Planner::plan(const NavGrid::Grid& grid, int start, int goal, std::vector<int>& cells) {
+			cells.clear();
+			expansions = 0;
+			bool canRepair = goal == goalCell && width == grid.width && height == grid.height &&
+							 grid.changesSince(version, changes);
+			goalIsObstacle = grid.isObstacle(goal);
+			if (!canRepair) {
+				restart(grid, start, goal);
+			} else {
+				keyModifier += aStar::octileDistance(grid, startCell, start);
+				startCell = start;
+				//a cell's cost changes the steps onto it and the diagonals cutting its corners, all of which start next to it
+				for (const NavGrid::ChangedArea& change : changes) {
+					int minCol = std::max(change.minCol - 1, 0), maxCol = std::min(change.maxCol + 1, grid.width - 1);
+					int minRow = std::max(change.minRow - 1, 0), maxRow = std::min(change.maxRow + 1, grid.height - 1);
+					for (int row = minRow; row <= maxRow; row++) {
+						for (int col = minCol; col <= maxCol; col++) {
+							updateVertex(grid, grid.index(col, row));
+						}
+					}
+				}
+			}
+			version = grid.version;
+			computeShortestPath(grid);
+
+			if (getState(startCell).rhs == INFINITE_COST) {
+				return false;
+			}
+			//walk downhill, the costs around the path are all settled
+			int current = startCell;
+			cells.push_back(current);
+			while (current != goalCell) {
+				int best = -1, bestCost = INFINITE_COST;
+				for (int i = 0; i < (int) moves.size(); i++) {
+					int cost = stepCost(grid, current, i);
+					if (cost == INFINITE_COST) {
+						continue;
+					}
+					int next = current + grid.stepOffset(i);
+					int g = getState(next).g;
+					if (g != INFINITE_COST && g + cost < bestCost) {
+						best = next;
+						bestCost = g + cost;
+					}
+				}
+				if (best < 0 || (int) cells.size() > grid.cellCount()) {
+					cells.clear();
+					return false;
+				}
+				current = best;
+				cells.push_back(current);
+			}
+			return true;
+		}
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "navgrid.hpp"
+#include "pathfinder.hpp"
+
+/* D* Lite (Koenig and Likhachev 2002) for units that keep walking the same order while the level changes around them.
+the search runs backwards from the goal, so every cell it has settled knows its cost to the goal no matter where the unit
+is standing now. when buildings go up only the cells around them get their costs re-checked, and only the part of the
+search tree that actually depended on those cells is searched again*/
+namespace AI {
+	namespace dStarLite {
+		// one unit's search, keep it around between plans to the same goal
+		class Planner {
+		public:
+			/* fills cells with every cell from startCell to goalCell (both included), same costs and moves as A*.
+			if the last plan went to the same goal on this grid only the cells changed since then are repaired,
+			otherwise the search starts over. returns false if the goal can't be reached*/
+			bool plan(const NavGrid::Grid& grid, int startCell, int goalCell, std::vector<int>& cells);
+
+			// true if the last plan was made against the current version of grid
+			bool isUpToDate(const NavGrid::Grid& grid) const {
+				return goalCell >= 0 && version == grid.version;
+			}
+
+			int goal() const {
+				return goalCell;
+			}
+
+			// drops the search state
+			void reset();
+
+			// cells expanded by the last call to plan
+			int lastExpansions() const {
+				return expansions;
+			}
+
+			// cells the search holds costs for
+			int stateCount() const {
+				return (int) states.size();
+			}
+
+		private:
+			struct State {
+				int g;
+				int rhs; //one step lookahead, g is out of date wherever the two differ
+			};
+
+			struct Key {
+				int first, second;
+
+				bool operator<(const Key& other) const {
+					return first < other.first || (first == other.first && second < other.second);
+				}
+			};
+
+			struct QueueEntry {
+				Key key;
+				int cell;
+			};
+
+			int goalCell = -1;
+			int startCell = -1;
+			int width = 0;
+			int height = 0;
+			unsigned int version = 0;
+			int keyModifier = 0; //km in the paper, keeps old keys valid as the unit walks away from where they were computed
+			int expansions = 0;
+			bool goalIsObstacle = false; //as of this plan, the masks treat it as closed so moves near it are checked by hand
+			std::unordered_map<int, State> states; //only cells the search touched, anything else has g = rhs = infinity
+			std::vector<QueueEntry> queue; //binary heap, holds stale entries that get skipped when popped
+			std::vector<NavGrid::ChangedArea> changes;
+
+			State getState(int cell) const;
+
+			Key calculateKey(const NavGrid::Grid& grid, int cell, const State& state) const;
+
+			// cost of the move from cell in NavGrid::neighborDirections[direction], infinity if the step isn't allowed
+			int stepCost(const NavGrid::Grid& grid, int cell, int direction) const;
+
+			bool isOpen(const NavGrid::Grid& grid, int col, int row) const;
+
+			void updateVertex(const NavGrid::Grid& grid, int cell);
+
+			void push(const Key& key, int cell);
+
+			void computeShortestPath(const NavGrid::Grid& grid);
+
+			void restart(const NavGrid::Grid& grid, int start, int goal);
+		};
+	}
+}
@@ -1,6 +1,11 @@
 #define _USE_MATH_DEFINES // Needed for M_PI
 
+#include <cmath>
+#include <limits>
 #include "entity.hpp"
+#include "cooperative.hpp"
+#include "pathindex.hpp"
+#include "regions.hpp"
 #include "pathfinder.hpp"  //for astar stuff
 #include "coord.hpp"
 #include "global.hpp"
@@ -10,7 +15,13 @@ Entity::Entity() : meshType(Model::MeshType::BALL), geometryRenderer(Model::mesh
 
 Entity::Entity(Model::MeshType geometry) : meshType(geometry), geometryRenderer(Model::meshRenderers[geometry]) {}
 
-Entity::~Entity() = default;
+Entity::Entity(Model::MeshType geometry, RigidBody::WithoutGeometry withoutGeometry) : meshType(geometry),
+	geometryRenderer(Model::meshRenderers[geometry]), hasPhysics(false), rigidBody(withoutGeometry) {}
+
+Entity::~Entity() {
+	AI::pathIndex::remove(this);
+	AI::cooperative::reservations.release(this);
+}
 
 //example of using the animate function when overriding Entity
 void Entity::animate(float ms) {
@@ -18,6 +29,9 @@ void Entity::animate(float ms) {
 }
 
 void Entity::softDelete() {
+	cancelPathRequest();
+	AI::pathIndex::remove(this);
+	AI::cooperative::reservations.release(this);
 	geometryRenderer.removeSelf();
 	rigidBody.removeSelf();
 	isDeleted = true;
@@ -119,22 +133,98 @@ void Entity::setPositionFast(int modelIndex, glm::vec3 position) {
 }
 
 void Entity::setTargetPath(const std::vector<glm::vec3>& targetPath) {
+	flowField = nullptr;
 	unitComp.targetPathStartTimestamp = 0;
+	unitComp.targetPathSegment = 0;
+	unitComp.targetPathSegmentStart = 0;
 	unitComp.targetPath = targetPath;
+	unitComp.targetPathTimes.clear();
+	AI::pathIndex::add(this, targetPath, destinationOptions.agentSize);
+	AI::cooperative::reservations.release(this);
 }
 
 void Entity::moveTo(UnitState unitState, const glm::vec3& moveToTarget, bool queueMove) {
     this->unitComp.state = unitState;
     if (!queueMove) {
         destinations.clear(); // Clear the queue
-        cleanUpTargetPath();
+        cancelPathRequest();
+        orderChanged = true; // Keep walking the old path until the new one has been found
     }
     hasDestination = true;
-    destinations.push_back(moveToTarget);
+    destinations.emplace_back(moveToTarget, pathOptions);
+}
+
+void Entity::moveToWithFlowField(UnitState unitState, const glm::vec3& moveToTarget,
+								 std::shared_ptr<const AI::flowField::FlowField> field, bool queueMove) {
+	moveTo(unitState, moveToTarget, queueMove);
+	if (!destinations.empty() && destinations.back().position == moveToTarget) { //things that can't move ignore moveTo
+		destinations.back().flowField = std::move(field);
+	}
+}
+
+void Entity::moveToWithPathOptions(UnitState unitState, const glm::vec3& moveToTarget, const AI::aStar::PathOptions& options,
+								   bool queueMove) {
+	moveTo(unitState, moveToTarget, queueMove);
+	if (!destinations.empty() && destinations.back().position == moveToTarget) {
+		destinations.back().pathOptions = options;
+	}
+}
+
+//returns false if the field can't get us anywhere from here
+bool Entity::startFollowingFlowField(const std::shared_ptr<const AI::flowField::FlowField>& field) {
+	const AI::NavGrid::Grid& grid = AI::NavGrid::grid;
+	Coord cell = getPositionInt();
+	if (!grid.withinBounds(cell.colCoord, cell.rowCoord)) {
+		return false;
+	}
+	std::shared_ptr<const AI::flowField::FlowField> current = AI::flowField::refresh(field);
+	if (!current->reaches(grid.index(cell.colCoord, cell.rowCoord))) {
+		return false;
+	}
+
+	flowField = current;
+	unitComp.targetPath.clear();
+	AI::pathIndex::remove(this);
+	flowStepEnd = getPosition();
+	unitComp.targetPathStartTimestamp = 0;
+	takeFlowFieldStep();
+	return true;
+}
+
+//moves on to the next cell of the flow field. once in the goal area the last stretch to our own spot is a normal path
+void Entity::takeFlowFieldStep() {
+	const AI::NavGrid::Grid& grid = AI::NavGrid::grid;
+	flowStepStart = flowStepEnd;
+	flowField = AI::flowField::refresh(flowField); //buildings might have gone up since the last step
+	int cell = grid.index(int(flowStepStart.x + 0.5), int(flowStepStart.z + 0.5));
+	int next = flowField->nextCell(cell);
+	if (next < 0) {
+		flowField = nullptr;
+		setTargetPath(AI::aStar::findPath(flowStepStart, currentDestination, destinationOptions).second);
+		return;
+	}
+	flowStepEnd = glm::vec3(grid.colOf(next), 0, grid.rowOf(next));
+}
+
+void Entity::followFlowField(double elapsed_time) {
+	unitComp.targetPathStartTimestamp += elapsed_time;
+	double stepTime = 1000.0 / unitComp.movementSpeed; //one cell per step, same speed as following a path
+	while (flowField && unitComp.targetPathStartTimestamp >= stepTime) {
+		unitComp.targetPathStartTimestamp -= stepTime;
+		takeFlowFieldStep();
+	}
+
+	if (!flowField) { //switched over to the path for the last stretch
+		computeNextMoveLocation(0);
+		return;
+	}
+	nextPosition = glm::mix(flowStepStart, flowStepEnd, float(unitComp.targetPathStartTimestamp / stepTime));
+	rigidBody.setVelocity(nextPosition - rigidBody.getPosition());
 }
 
 void Entity::stopMoving() {
 	this->unitComp.state = UnitState::IDLE;
+	cancelPathRequest();
 	destinations.clear();
 	hasDestination = false;
 	unitComp.targetPath.clear();
@@ -143,19 +233,51 @@ void Entity::stopMoving() {
 
 //returns a pathIndex and a 0.00 - 0.99 value to interpolate between steps in a path
 std::pair<int, float> Entity::getInterpolationPercentage() {
-	float intermediateVal = (unitComp.targetPathStartTimestamp / 1000) * unitComp.movementSpeed;
-	int pathIndex = (int) intermediateVal;
-	float interpolationPercent = clamp<float>(0, intermediateVal - pathIndex, 1);
-	return {pathIndex, interpolationPercent};
+	float walked = float(unitComp.targetPathStartTimestamp / 1000) * unitComp.movementSpeed;
+	const std::vector<glm::vec3>& path = unitComp.targetPath;
+	const std::vector<float>& times = unitComp.targetPathTimes;
+	int& pathIndex = unitComp.targetPathSegment;
+	if (times.size() == path.size()) { //timed path, waypoints are reached when the plan says and not before
+		float now = float(unitComp.targetPathStartTimestamp);
+		while (pathIndex < (int) path.size() - 1 && now >= times[pathIndex + 1]) {
+			pathIndex++;
+		}
+		if (pathIndex >= (int) path.size() - 1) {
+			return {pathIndex, 0};
+		}
+		return {pathIndex, clamp<float>(0, (now - times[pathIndex]) / (times[pathIndex + 1] - times[pathIndex]), 1)};
+	}
+	//waypoints can be any distance apart, move on past every one we've walked far enough to reach
+	while (pathIndex < (int) path.size() - 1) {
+		float length = glm::length(path[pathIndex + 1] - path[pathIndex]);
+		if (walked < unitComp.targetPathSegmentStart + length) {
+			float interpolationPercent = clamp<float>(0, (walked - unitComp.targetPathSegmentStart) / length, 1);
+			return {pathIndex, interpolationPercent};
+		}
+		unitComp.targetPathSegmentStart += length;
+		pathIndex++;
+	}
+	return {pathIndex, 0};
 }
 
-//returns true if this entity can move on the next update
+//returns true if this entity is moving or about to
 bool Entity::hasMoveTarget() {
-	return !this->unitComp.targetPath.empty();
+	return isWalking() || pathRequest != AI::pathRequests::NO_REQUEST;
+}
+
+bool Entity::isWalking() {
+	return !this->unitComp.targetPath.empty() || flowField != nullptr;
 }
 
 void Entity::computeNextMoveLocation(double elapsed_time) {
-	if (!hasMoveTarget()) {
+	if (!isWalking()) {
+		if (rigidBody.getVelocity() != glm::vec3(0, 0, 0)) {
+			rigidBody.setVelocity({0, 0, 0}); //stopped, lets the collision detector put us to sleep
+		}
+		return;
+	}
+	if (flowField) {
+		followFlowField(elapsed_time);
 		return;
 	}
 
@@ -173,31 +295,270 @@ void Entity::computeNextMoveLocation(double elapsed_time) {
 	rigidBody.setVelocity(nextPosition - rigidBody.getPosition());
 }
 
-void Entity::move(double elapsed_time) {
-	if (!hasMoveTarget()) {
-		if (!destinations.empty()) {
-			currentDestination = destinations.front(); //get the next dest
-			destinations.pop_front();
-			setTargetPath(AI::aStar::findPath(this->getPosition(), currentDestination).second);
+void Entity::startNextDestination() {
+	Destination destination = destinations.front(); //get the next dest
+	destinations.pop_front();
+	currentDestination = destination.position;
+	destinationOptions = destination.pathOptions;
+	orderChanged = false;
+	if (destination.flowField && startFollowingFlowField(destination.flowField)) {
+		return;
+	}
+	if (destinationOptions.mode == AI::aStar::SearchMode::INCREMENTAL) {
+		planIncremental();
+	} else if (destinationOptions.mode == AI::aStar::SearchMode::COOPERATIVE) {
+		planCooperative();
+	} else {
+		pathRequest = AI::pathRequests::request(this->getPosition(), currentDestination, destinationOptions, pathPriority());
+	}
+}
+
+AI::pathRequests::Priority Entity::pathPriority() const {
+	if (aiComp.owner == GamePieceOwner::PLAYER) {
+		return AI::pathRequests::Priority::PLAYER;
+	}
+	return unitComp.state == UnitState::SCOUT ? AI::pathRequests::Priority::SCOUTING : AI::pathRequests::Priority::AI;
+}
+
+void Entity::planIncremental() {
+	const AI::NavGrid::Grid& grid = AI::NavGrid::agentGrid(destinationOptions.agentSize);
+	glm::vec3 position = getPosition();
+	int col = int(position.x + 0.5), row = int(position.z + 0.5);
+	int goalCol = int(currentDestination.x + 0.5), goalRow = int(currentDestination.z + 0.5);
+	if (!grid.withinBounds(col, row) || !grid.withinBounds(goalCol, goalRow)) {
+		setTargetPath(AI::aStar::findPath(position, currentDestination, destinationOptions).second); //same errors as any other search
+		return;
+	}
+
+	if (!planner) {
+		planner = std::make_shared<AI::dStarLite::Planner>();
+	}
+	static std::vector<int> cells;
+	int startCell = grid.index(col, row), goalCell = grid.index(goalCol, goalRow);
+	if (!AI::regions::canReach(grid, startCell, goalCell) || !planner->plan(grid, startCell, goalCell, cells)) {
+		setTargetPath({});
+		return;
+	}
+	std::vector<glm::vec3> path = AI::aStar::cellsToPath(grid, cells, position, currentDestination);
+	if (destinationOptions.smooth) {
+		AI::aStar::smoothPath(grid, path, goalCell);
+	}
+	setTargetPath(path);
+}
+
+void Entity::planCooperative() {
+	const AI::NavGrid::Grid& grid = AI::NavGrid::agentGrid(destinationOptions.agentSize);
+	AI::cooperative::ReservationTable& reservations = AI::cooperative::reservations;
+	glm::vec3 position = getPosition();
+	int col = int(position.x + 0.5), row = int(position.z + 0.5);
+	int goalCol = int(currentDestination.x + 0.5), goalRow = int(currentDestination.z + 0.5);
+	if (!grid.withinBounds(col, row) || !grid.withinBounds(goalCol, goalRow)) {
+		setTargetPath(AI::aStar::findPath(position, currentDestination, destinationOptions).second); //same errors as any other search
+		return;
+	}
+
+	//in the middle of a plan we carry on from the waypoint we're walking to, so there's no jump in where we are
+	std::vector<glm::vec3> path;
+	std::vector<float> times;
+	int startCell, startStep;
+	int walkingFrom = -1; //cell we're leaving while walking to startCell
+	bool continuing = !flowField && !unitComp.targetPath.empty() &&
+					  unitComp.targetPathTimes.size() == unitComp.targetPath.size();
+	if (continuing) {
+		int index = getInterpolationPercentage().first;
+		int next = std::min(index + 1, (int) unitComp.targetPath.size() - 1);
+		path.assign(unitComp.targetPath.begin(), unitComp.targetPath.begin() + next + 1);
+		times.assign(unitComp.targetPathTimes.begin(), unitComp.targetPathTimes.begin() + next + 1);
+		startCell = grid.index(int(path.back().x + 0.5), int(path.back().z + 0.5));
+		startStep = cooperativeStartStep + (int) std::lround(times.back() / AI::cooperative::STEP_MS);
+		walkingFrom = grid.index(int(path[index].x + 0.5), int(path[index].z + 0.5));
+	} else {
+		path.push_back(position);
+		times.push_back(0);
+		startCell = grid.index(col, row);
+		startStep = reservations.currentStep();
+		cooperativeStartStep = startStep;
+	}
+	reservations.release(this);
+
+	int goalCell = grid.index(goalCol, goalRow);
+	if (!AI::regions::canReach(grid, startCell, goalCell)) {
+		setTargetPath({});
+		return;
+	}
+	static std::vector<AI::cooperative::Arrival> arrivals;
+	if (!AI::cooperative::plan(grid, reservations, AI::landmarks::landmarks, startCell, startStep, goalCell,
+							   unitComp.movementSpeed, this, arrivals)) {
+		arrivals.assign(1, {startCell, startStep + 1}); //boxed in, stay put for a step and try again
+	}
+	if (continuing) {
+		reservations.reserve(walkingFrom, reservations.currentStep(), startStep, this);
+		reservations.reserve(startCell, reservations.currentStep(), startStep, this);
+	}
+	reservations.reservePlan(startCell, startStep, arrivals, this);
+
+	for (const AI::cooperative::Arrival& arrival : arrivals) {
+		path.emplace_back(grid.colOf(arrival.cell), 0, grid.rowOf(arrival.cell));
+		times.push_back(float((arrival.step - cooperativeStartStep) * AI::cooperative::STEP_MS));
+	}
+	if (arrivals.back().cell == goalCell) {
+		path.back() = currentDestination;
+		cooperativeReplanTime = std::numeric_limits<double>::infinity();
+	} else {
+		//plan the next window halfway thru this one, or just before the end if it's shorter than that
+		int replanStep = std::min(startStep + AI::cooperative::WINDOW_STEPS / 2, arrivals.back().step - 1);
+		cooperativeReplanTime = std::max(replanStep - cooperativeStartStep, 0) * AI::cooperative::STEP_MS;
+	}
+
+	flowField = nullptr;
+	if (!continuing) {
+		unitComp.targetPathStartTimestamp = 0;
+		unitComp.targetPathSegment = 0;
+	}
+	unitComp.targetPath = path;
+	unitComp.targetPathTimes = times;
+	AI::pathIndex::add(this, path, destinationOptions.agentSize);
+}
+
+//picks up the path once a worker has found it
+void Entity::receivePath() {
+	std::pair<bool, std::vector<glm::vec3>> result;
+	if (pathImprovements != AI::pathRequests::NO_REQUEST && AI::pathRequests::takeResult(pathImprovements, result)) {
+		takeImprovedPath(result.second);
+	}
+	if (pathRequest == AI::pathRequests::NO_REQUEST || !AI::pathRequests::takeResult(pathRequest, result)) {
+		return;
+	}
+	if (destinationOptions.mode == AI::aStar::SearchMode::WEIGHTED && result.first) {
+		AI::pathRequests::cancel(pathImprovements);
+		pathImprovements = pathRequest; //better paths keep coming under the same id
+	}
+	pathRequest = AI::pathRequests::NO_REQUEST;
+	if (!result.second.empty()) {
+		result.second.front() = getPosition(); //we might have kept walking while it was being searched for
+	}
+	setTargetPath(result.second);
+}
+
+void Entity::cancelPathRequest() {
+	AI::pathRequests::cancel(pathRequest);
+	pathRequest = AI::pathRequests::NO_REQUEST;
+	AI::pathRequests::cancel(pathImprovements);
+	pathImprovements = AI::pathRequests::NO_REQUEST;
+}
+
+void Entity::takeImprovedPath(std::vector<glm::vec3> path) {
+	if (unitComp.targetPath.empty() || path.size() < 2) {
+		return;
+	}
+	const AI::NavGrid::Grid& grid = AI::NavGrid::agentGrid(destinationOptions.agentSize);
+	glm::vec3 position = getPosition();
+	int col = int(position.x + 0.5), row = int(position.z + 0.5);
+	if (!grid.withinBounds(col, row)) {
+		return;
+	}
+	int cell = grid.index(col, row);
+	int goalCell = grid.index(int(path.back().x + 0.5), int(path.back().z + 0.5));
+
+	//how much further we'd walk on the path we have
+	std::pair<int, float> index = getInterpolationPercentage();
+	std::vector<glm::vec3>& current = unitComp.targetPath;
+	float remaining = 0;
+	if (index.first + 1 < (int) current.size()) {
+		remaining = glm::length(current[index.first + 1] - position);
+		for (size_t i = index.first + 2; i < current.size(); i++) {
+			remaining += glm::length(current[i] - current[i - 1]);
 		}
+	}
+
+	//join the new path as far along as we can walk to in a straight line
+	float rest = 0;
+	for (int join = (int) path.size() - 1; join >= 1; join--) {
+		if (join + 1 < (int) path.size()) {
+			rest += glm::length(path[join + 1] - path[join]);
+		}
+		int joinCell = grid.index(int(path[join].x + 0.5), int(path[join].z + 0.5));
+		if (!AI::aStar::lineOfSight(grid, cell, joinCell, Config::OBSTACLE_COST - 1, goalCell)) {
+			continue;
+		}
+		if (glm::length(path[join] - position) + rest >= remaining) {
+			return; //the old path is no worse from where we are now
+		}
+		path.erase(path.begin() + 1, path.begin() + join);
+		path.front() = position;
+		setTargetPath(path);
 		return;
 	}
+}
 
-	bool hasCollision = !rigidBody.getAllCollisions().empty();
+void Entity::repath() {
+	if (unitComp.targetPath.empty()) {
+		return; //flow fields and paths that are done don't need it
+	}
+	cancelPathRequest(); //anything still being searched for was searched against the old level
+	if (destinationOptions.mode == AI::aStar::SearchMode::INCREMENTAL) {
+		planIncremental();
+	} else if (destinationOptions.mode == AI::aStar::SearchMode::COOPERATIVE) {
+		planCooperative();
+	} else {
+		pathRequest = AI::pathRequests::request(this->getPosition(), currentDestination, destinationOptions, pathPriority());
+	}
+}
+
+void Entity::move(double elapsed_time) {
+	bool walking = isWalking(); //nextPosition is only up to date if we were walking when it was computed
+	receivePath();
+	if (pathRequest == AI::pathRequests::NO_REQUEST && !destinations.empty() && (!walking || orderChanged)) {
+		startNextDestination();
+	}
+	if (!walking) {
+		return;
+	}
+	if (needsRepath) {
+		needsRepath = false;
+		repath();
+	} else if (isCooperative() && unitComp.targetPathStartTimestamp >= cooperativeReplanTime) {
+		planCooperative(); //halfway thru the window, plan the next one before we run out of path
+	}
+
+	bool hasCollision = rigidBody.hasContact();
+	CollisionDetection::CollisionInfo impact = rigidBody.getFirstImpact();
+	if (hasPhysics && impact.collided && collisionCooldown <= 0 && elapsed_time > 0) {
+		//fast enough to get past whatever is in the way before a pass sees them overlap, stop where we hit it
+		glm::vec3 position = rigidBody.getPosition();
+		nextPosition = position + (nextPosition - position) * float(impact.time / elapsed_time);
+		hasCollision = true;
+	}
 	if (!hasPhysics || !hasCollision || collisionCooldown > 0) {
 		setPositionFast(0, nextPosition); //for rendering
 		rigidBody.setPosition(nextPosition); //for phys
 		if (collisionCooldown > 0)collisionCooldown -= elapsed_time;
 	} else {
-		CollisionDetection::CollisionInfo collision = rigidBody.getFirstCollision();
-		if (hasDestination) {
+		CollisionDetection::CollisionInfo collision = impact.collided ? impact : rigidBody.getFirstCollision();
+		//units sharing the reservation table planned around each other, brushing past one is not worth a detour
+		AI::cooperative::ReservationTable& reservations = AI::cooperative::reservations;
+		int otherCol = int(collision.otherPos.x + 0.5), otherRow = int(collision.otherPos.z + 0.5);
+		bool planned = isCooperative() && AI::NavGrid::grid.withinBounds(otherCol, otherRow) &&
+					   !reservations.isFree(AI::NavGrid::grid.index(otherCol, otherRow), reservations.currentStep(), this);
+		if (planned) {
+			setPositionFast(0, nextPosition);
+			rigidBody.setPosition(nextPosition);
+		} else if (hasDestination) {
+			if (impact.collided) {
+				setPositionFast(0, nextPosition); //up to where we hit it, the detour starts from there
+				rigidBody.setPosition(nextPosition);
+			}
 			glm::vec3 vecFromOther = getPosition() - collision.otherPos;
 			glm::vec3 bounceDir = glm::cross(vecFromOther, {0, 1, 0});
 			glm::vec3 destination = getPosition() + vecFromOther;
-			destinations.emplace_front(currentDestination);
-			destinations.emplace_front(destination);
+			//the detour and the rest of the order are searched for the same way the order was
+			destinations.emplace_front(currentDestination, destinationOptions, flowField);
+			destinations.emplace_front(destination, destinationOptions);
 			currentDestination = destination;
 			unitComp.targetPath.clear();
+			AI::pathIndex::remove(this);
+			flowField = nullptr;
+			cancelPathRequest();
 			collisionCooldown = 10.0f;
 		}
 	}
@@ -206,6 +567,12 @@ void Entity::move(double elapsed_time) {
 //dont erase targetDest so aimanager can clean up the in progress scouting targets
 void Entity::cleanUpTargetPath() {
 	unitComp.targetPath.clear();
+	unitComp.targetPathTimes.clear();
+	AI::pathIndex::remove(this);
+	AI::cooperative::reservations.release(this);
+	AI::pathRequests::cancel(pathImprovements); //there already
+	pathImprovements = AI::pathRequests::NO_REQUEST;
+	flowField = nullptr;
 	unitComp.state = UnitState::IDLE;
 }
 
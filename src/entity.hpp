@@ -8,13 +8,28 @@
 // custom headers
 
 #include "aicomp.hpp"
+#include "dstarlite.hpp"
+#include "flowfield.hpp"
 #include "model.hpp"
+#include "pathfinder.hpp"
+#include "pathrequests.hpp"
 #include "renderer.hpp"
 #include "rigidBody.hpp"
 #include "unitcomp.hpp"
 #include <deque>
 #include "weapons.hpp"
 
+// a queued move order, group orders carry the flow field the whole group shares
+struct Destination {
+	glm::vec3 position;
+	std::shared_ptr<const AI::flowField::FlowField> flowField;
+	AI::aStar::PathOptions pathOptions; //how the path there is searched for, the entity's pathOptions unless the order said otherwise
+
+	Destination(const glm::vec3& position, const AI::aStar::PathOptions& pathOptions,
+				std::shared_ptr<const AI::flowField::FlowField> flowField = nullptr) :
+			position(position), flowField(std::move(flowField)), pathOptions(pathOptions) {}
+};
+
 class Entity {
 public:
 	//members
@@ -23,9 +38,20 @@ public:
 	AiComp aiComp;
 	UnitComp unitComp;
 	bool hasDestination = false;
-	std::deque<glm::vec3> destinations;
+	std::deque<Destination> destinations;
 	glm::vec3 currentDestination;
+	std::shared_ptr<const AI::flowField::FlowField> flowField; //set while walking a flow field instead of unitComp.targetPath
+	glm::vec3 flowStepStart, flowStepEnd; //the cell to cell step being walked on the flow field
 	float collisionCooldown = 0;
+	AI::aStar::PathOptions pathOptions{AI::aStar::SearchMode::HIERARCHICAL, 1, true, true}; //how this entity's paths are searched for
+	AI::aStar::PathOptions destinationOptions; //pathOptions of the order being walked
+	AI::pathRequests::RequestId pathRequest = AI::pathRequests::NO_REQUEST; //path being searched for on a worker
+	AI::pathRequests::RequestId pathImprovements = AI::pathRequests::NO_REQUEST; //WEIGHTED request still finding better paths
+	bool orderChanged = false; //a new order came in while walking, replace the current path once the new one is ready
+	std::shared_ptr<AI::dStarLite::Planner> planner; //search kept between plans when destinationOptions.mode is INCREMENTAL
+	bool needsRepath = false; //the level changed under the path we're walking, set by UnitManager from AI::pathIndex
+	int cooperativeStartStep = 0; //reservation table step the timed path started at, when destinationOptions.mode is COOPERATIVE
+	double cooperativeReplanTime = 0; //targetPathStartTimestamp at which the next window gets planned
 
 	bool hasPhysics = true; // Set to false if we want to avoid any expensive physics computations for the object
 	bool isDeleted = false;
@@ -41,6 +67,9 @@ public:
 
 	Entity(Model::MeshType geometry);
 
+	// an entity without physics, its rigid body never gets a collision box
+	Entity(Model::MeshType geometry, RigidBody::WithoutGeometry);
+
 	virtual ~Entity();
 
 	// functions
@@ -101,8 +130,50 @@ public:
 
 	bool hasMoveTarget();
 
+	// true while there is a path or flow field to walk, a path still being searched for doesn't count
+	bool isWalking();
+
+	void startNextDestination();
+
+	void receivePath();
+
+	void cancelPathRequest();
+
+	// switches to a better path for the same order if it can be joined from here and gets us there sooner
+	void takeImprovedPath(std::vector<glm::vec3> path);
+
+	// player orders get searched first, scouting last
+	AI::pathRequests::Priority pathPriority() const;
+
+	// paths to currentDestination with the planner on the spot, repairing the last search if it went to the same place
+	void planIncremental();
+
+	// plans the next window around the other units' reservations, carrying on from the waypoint we're walking to
+	void planCooperative();
+
+	bool isCooperative() const {
+		return destinationOptions.mode == AI::aStar::SearchMode::COOPERATIVE && !unitComp.targetPathTimes.empty();
+	}
+
+	// searches again from here to currentDestination, keeps walking the current path until the new one is found
+	void repath();
+
 	virtual void moveTo(UnitState unitState, const glm::vec3& moveToTarget, bool queueMove = false);
 
+	// same as moveTo but the unit follows the flow field into the goal area and only paths the last few cells to moveToTarget
+	void moveToWithFlowField(UnitState unitState, const glm::vec3& moveToTarget,
+							 std::shared_ptr<const AI::flowField::FlowField> field, bool queueMove = false);
+
+	// same as moveTo but the path is searched for with options instead of pathOptions
+	void moveToWithPathOptions(UnitState unitState, const glm::vec3& moveToTarget, const AI::aStar::PathOptions& options,
+							   bool queueMove = false);
+
+	bool startFollowingFlowField(const std::shared_ptr<const AI::flowField::FlowField>& field);
+
+	void takeFlowFieldStep();
+
+	void followFlowField(double elapsed_time);
+
 	void cleanUpTargetPath();
 
 	void computeNextMoveLocation(double elapsed_time);
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <functional>
+#include <map>
+#include "flowfield.hpp"
+#include "pathfinder.hpp" //for movement costs
+
+namespace AI {
+	namespace flowField {
+		const int MAX_UNUSED_FIELDS = 8; //fields nobody is following that are kept around in case the same order comes again
+
+		std::map<std::vector<int>, std::shared_ptr<FlowField>> cache;
+
+		int FlowField::nextCell(int cell) const {
+			int direction = directions[cell];
+			if (direction == NO_DIRECTION) {
+				return -1;
+			}
+			int col = cell % width + NavGrid::neighborDirections[direction].first;
+			int row = cell / width + NavGrid::neighborDirections[direction].second;
+			return row * width + col;
+		}
+
+		void build(const NavGrid::Grid& grid, const std::vector<int>& goalCells, FlowField& field) {
+			field.goalCells = goalCells;
+			field.version = grid.version;
+			field.width = grid.width;
+			field.integration.assign(grid.cellCount(), UNREACHABLE);
+			field.directions.assign(grid.cellCount(), NO_DIRECTION);
+
+			// min heap of (cost to goal, cell)
+			std::vector<std::pair<int, int>> frontier;
+			for (int cell : goalCells) {
+				if (cell >= 0 && cell < grid.cellCount() && field.integration[cell] != 0) {
+					field.integration[cell] = 0;
+					frontier.emplace_back(0, cell);
+				}
+			}
+
+			//goals inside buildings count as open, which the neighbour masks don't know about
+			bool goalsOpen = std::none_of(goalCells.begin(), goalCells.end(), [&](int cell) {
+				return cell >= 0 && cell < grid.cellCount() && grid.isObstacle(cell);
+			});
+			auto isOpen = [&](int col, int row) {
+				if (!grid.withinBounds(col, row)) {
+					return false;
+				}
+				int cell = grid.index(col, row);
+				return !grid.isObstacle(cell) || field.isGoal(cell);
+			};
+
+			/* runs backwards from the goals: every cell we pop is somewhere a unit can step onto,
+			so we work out which neighbours could step onto it and what that would cost them*/
+			while (!frontier.empty()) {
+				std::pop_heap(frontier.begin(), frontier.end(), std::greater<std::pair<int, int>>());
+				std::pair<int, int> current = frontier.back();
+				frontier.pop_back();
+
+				int cell = current.second;
+				if (current.first > field.integration[cell]) {
+					continue; //stale entry
+				}
+
+				int col = grid.colOf(cell);
+				int row = grid.rowOf(cell);
+				//a goal inside a building is free to step onto, that way units stop next to it
+				int enterCost = current.first + (grid.isObstacle(cell) ? 0 : grid.costs[cell]);
+				for (int i = 0; i < 8; i++) {
+					const std::pair<int, int>& step = NavGrid::neighborDirections[i];
+					int fromCol = col - step.first, fromRow = row - step.second;
+					bool diagonal = step.first != 0 && step.second != 0;
+					if (goalsOpen) {
+						//stepping from there to here is open iff stepping back is, corners and all
+						if (!grid.canStep(cell, NavGrid::oppositeDirection(i))) {
+							continue;
+						}
+					} else if (!isOpen(fromCol, fromRow) ||
+							   (diagonal && (!isOpen(fromCol, row) || !isOpen(col, fromRow)))) { //dont go thru diagonal corners
+						continue;
+					}
+
+					int from = grid.index(fromCol, fromRow);
+					int cost = enterCost + (diagonal ? aStar::DIAGONAL_MOVEMENT_COST : aStar::STRAIGHT_MOVEMENT_COST);
+					if (field.integration[from] == UNREACHABLE || cost < field.integration[from]) {
+						field.integration[from] = cost;
+						field.directions[from] = (int8_t) i;
+						frontier.emplace_back(cost, from);
+						std::push_heap(frontier.begin(), frontier.end(), std::greater<std::pair<int, int>>());
+					}
+				}
+			}
+		}
+
+		// the cache holds one reference, anything above that is a unit following the field
+		bool isUnused(const std::shared_ptr<FlowField>& field) {
+			return field.use_count() == 1;
+		}
+
+		void pruneCache() {
+			int unused = 0;
+			for (auto it = cache.begin(); it != cache.end();) {
+				if (isUnused(it->second) && !it->second->isCurrent()) {
+					it = cache.erase(it);
+				} else {
+					unused += isUnused(it->second);
+					++it;
+				}
+			}
+			for (auto it = cache.begin(); it != cache.end() && unused > MAX_UNUSED_FIELDS;) {
+				if (isUnused(it->second)) {
+					it = cache.erase(it);
+					unused--;
+				} else {
+					++it;
+				}
+			}
+		}
+
+		std::shared_ptr<const FlowField> getField(std::vector<int> goalCells) {
+			std::sort(goalCells.begin(), goalCells.end());
+			goalCells.erase(std::unique(goalCells.begin(), goalCells.end()), goalCells.end());
+			pruneCache();
+
+			std::shared_ptr<FlowField>& cached = cache[goalCells];
+			if (!cached || !cached->isCurrent()) {
+				//units still holding the old field keep it alive until they refresh
+				std::shared_ptr<FlowField> field = std::make_shared<FlowField>();
+				build(NavGrid::grid, goalCells, *field);
+				cached = field;
+			}
+			return cached;
+		}
+
+		std::shared_ptr<const FlowField> refresh(const std::shared_ptr<const FlowField>& field) {
+			if (field->isCurrent()) {
+				return field;
+			}
+			return getField(field->goalCells);
+		}
+
+		void clearCache() {
+			cache.clear();
+		}
+
+		int cachedFieldCount() {
+			return (int) cache.size();
+		}
+	}
+}
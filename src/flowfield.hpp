@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "navgrid.hpp"
+
+/* flow fields for group orders. one dijkstra from the goal cells fills in the cost of getting to the goal from every cell
+in the level, and each cell remembers which neighbour to step to next. a unit following the field only has to look up the
+cell it's standing on, so a group order costs one search no matter how many units are in the group*/
+namespace AI {
+	namespace flowField {
+		const int MIN_GROUP_SIZE = 4; //smaller groups are cheaper to path one unit at a time
+		const int NO_DIRECTION = -1;
+		const int UNREACHABLE = -1;
+
+		struct FlowField {
+			std::vector<int> goalCells; //sorted, these are the cells the field leads to
+			unsigned int version = 0; //NavGrid version the field was built against
+			int width = 0;
+			std::vector<int> integration; //cost of getting from each cell to the closest goal cell, UNREACHABLE if it can't
+			std::vector<int8_t> directions; //index into NavGrid::neighborDirections, NO_DIRECTION for goal cells and unreachable ones
+
+			bool reaches(int cell) const {
+				return cell >= 0 && cell < (int) integration.size() && integration[cell] != UNREACHABLE;
+			}
+
+			bool isGoal(int cell) const {
+				return reaches(cell) && integration[cell] == 0;
+			}
+
+			// the neighbour to step onto from cell, or -1 once a goal cell has been reached
+			int nextCell(int cell) const;
+
+			bool isCurrent() const {
+				return version == NavGrid::grid.version;
+			}
+		};
+
+		// builds a field over grid leading to goalCells. goal cells are treated as open even if they are obstacles
+		void build(const NavGrid::Grid& grid, const std::vector<int>& goalCells, FlowField& field);
+
+		/* returns the field leading to goalCells, building it against NavGrid::grid if there isn't an up to date one cached.
+		every caller asking for the same goal cells gets the same field, fields nobody holds on to anymore are dropped*/
+		std::shared_ptr<const FlowField> getField(std::vector<int> goalCells);
+
+		// the up to date version of field, rebuilt once for everyone following it after the level changes
+		std::shared_ptr<const FlowField> refresh(const std::shared_ptr<const FlowField>& field);
+
+		void clearCache();
+
+		int cachedFieldCount();
+	}
+}
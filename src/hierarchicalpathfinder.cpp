@@ -0,0 +1,308 @@
+#include <cstdlib>
+#include "hierarchicalpathfinder.hpp"
+
+namespace AI {
+	namespace hierarchical {
+		Graph graph;
+
+		/* A* from startCell to targetCell that never leaves the cluster. with no target (-1) it becomes a dijkstra
+		that reaches everything in the cluster, which is how entrance costs get worked out.
+		openCell counts as traversable even if it's an obstacle, same as the goal in aStar::getNeighbors*/
+		bool searchInCluster(const NavGrid::Grid& grid, const Cluster& cluster, int startCell, int targetCell, int openCell,
+							 aStar::SearchWorkspace& workspace) {
+			auto heuristic = [&](int cell) {
+				return targetCell < 0 ? 0 : aStar::octileDistance(grid, cell, targetCell);
+			};
+
+			workspace.beginSearch(grid.cellCount());
+			std::vector<aStar::FrontierNode>& frontier = workspace.frontier;
+			aStar::NeighborBuffer neighbors;
+
+			workspace.visit(startCell, 0, startCell);
+			frontier.push_back({(float) heuristic(startCell), startCell});
+
+			while (!frontier.empty()) {
+				std::pop_heap(frontier.begin(), frontier.end(), aStar::aStarComparator());
+				aStar::FrontierNode current = frontier.back();
+				frontier.pop_back();
+
+				if (current.cell == targetCell) {
+					return true;
+				}
+
+				int currentGScore = workspace.gScore(current.cell);
+				if (current.fScore > currentGScore + heuristic(current.cell)) {
+					continue; //stale entry
+				}
+
+				aStar::getNeighbors(grid, current.cell, openCell, neighbors);
+				for (const aStar::Neighbor& next : neighbors) {
+					if (!cluster.contains(grid.colOf(next.cell), grid.rowOf(next.cell))) {
+						continue;
+					}
+					int gScore = currentGScore + next.movementCost;
+					if (!workspace.isVisited(next.cell) || gScore < workspace.gScore(next.cell)) {
+						workspace.visit(next.cell, gScore, current.cell);
+						frontier.push_back({float(gScore + heuristic(next.cell)), next.cell});
+						std::push_heap(frontier.begin(), frontier.end(), aStar::aStarComparator());
+					}
+				}
+			}
+			return targetCell < 0;
+		}
+
+		void Graph::build(const NavGrid::Grid& grid) {
+			clustersWide = (grid.width + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+			clustersHigh = (grid.height + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+			clusters.assign(clustersWide * clustersHigh, Cluster());
+			entranceIndex.assign(grid.cellCount(), -1);
+
+			for (int clusterRow = 0; clusterRow < clustersHigh; clusterRow++) {
+				for (int clusterCol = 0; clusterCol < clustersWide; clusterCol++) {
+					Cluster& cluster = clusters[clusterRow * clustersWide + clusterCol];
+					cluster.minCol = clusterCol * CLUSTER_SIZE;
+					cluster.minRow = clusterRow * CLUSTER_SIZE;
+					cluster.maxCol = std::min(cluster.minCol + CLUSTER_SIZE, grid.width) - 1;
+					cluster.maxRow = std::min(cluster.minRow + CLUSTER_SIZE, grid.height) - 1;
+				}
+			}
+
+			aStar::SearchWorkspace& workspace = aStar::defaultWorkspace();
+			for (int i = 0; i < (int) clusters.size(); i++) {
+				rebuildCluster(grid, i, workspace);
+			}
+		}
+
+		void Graph::updateArea(const NavGrid::Grid& grid, int minCol, int minRow, int maxCol, int maxRow) {
+			if (clusters.empty()) {
+				return;
+			}
+			// entrances depend on the cells right across a border as well, so grow the area by one
+			int minClusterCol = std::max(minCol - 1, 0) / CLUSTER_SIZE;
+			int minClusterRow = std::max(minRow - 1, 0) / CLUSTER_SIZE;
+			int maxClusterCol = std::min(maxCol + 1, grid.width - 1) / CLUSTER_SIZE;
+			int maxClusterRow = std::min(maxRow + 1, grid.height - 1) / CLUSTER_SIZE;
+
+			aStar::SearchWorkspace& workspace = aStar::defaultWorkspace();
+			for (int clusterRow = minClusterRow; clusterRow <= maxClusterRow; clusterRow++) {
+				for (int clusterCol = minClusterCol; clusterCol <= maxClusterCol; clusterCol++) {
+					rebuildCluster(grid, clusterRow * clustersWide + clusterCol, workspace);
+				}
+			}
+		}
+
+		int Graph::clusterOf(const NavGrid::Grid& grid, int cell) const {
+			return (grid.rowOf(cell) / CLUSTER_SIZE) * clustersWide + grid.colOf(cell) / CLUSTER_SIZE;
+		}
+
+		bool Graph::isLocal(const NavGrid::Grid& grid, int cell, int otherCell) const {
+			return std::abs(grid.colOf(cell) / CLUSTER_SIZE - grid.colOf(otherCell) / CLUSTER_SIZE) <= 1 &&
+				   std::abs(grid.rowOf(cell) / CLUSTER_SIZE - grid.rowOf(otherCell) / CLUSTER_SIZE) <= 1;
+		}
+
+		int Graph::entranceCount() const {
+			int count = 0;
+			for (const Cluster& cluster : clusters) {
+				count += (int) cluster.entrances.size();
+			}
+			return count;
+		}
+
+		void Graph::rebuildCluster(const NavGrid::Grid& grid, int clusterIndex, aStar::SearchWorkspace& workspace) {
+			Cluster& cluster = clusters[clusterIndex];
+			for (int cell : cluster.entrances) {
+				entranceIndex[cell] = -1;
+			}
+			cluster.entrances.clear();
+			cluster.edges.clear();
+
+			int width = cluster.maxCol - cluster.minCol + 1;
+			int height = cluster.maxRow - cluster.minRow + 1;
+			int clusterCol = clusterIndex % clustersWide;
+			int clusterRow = clusterIndex / clustersWide;
+			if (clusterRow > 0) { //top
+				addBorderEntrances(grid, cluster, cluster.minCol, cluster.minRow, 1, 0, width, 0, -1);
+			}
+			if (clusterRow < clustersHigh - 1) { //bottom
+				addBorderEntrances(grid, cluster, cluster.minCol, cluster.maxRow, 1, 0, width, 0, 1);
+			}
+			if (clusterCol > 0) { //left
+				addBorderEntrances(grid, cluster, cluster.minCol, cluster.minRow, 0, 1, height, -1, 0);
+			}
+			if (clusterCol < clustersWide - 1) { //right
+				addBorderEntrances(grid, cluster, cluster.maxCol, cluster.minRow, 0, 1, height, 1, 0);
+			}
+
+			cluster.edges.resize(cluster.entrances.size());
+			for (int i = 0; i < (int) cluster.entrances.size(); i++) {
+				searchInCluster(grid, cluster, cluster.entrances[i], -1, -1, workspace);
+				for (int other : cluster.entrances) {
+					if (other != cluster.entrances[i] && workspace.isVisited(other)) {
+						cluster.edges[i].push_back({other, workspace.gScore(other)});
+					}
+				}
+			}
+		}
+
+		/* walks length cells of one border from (col, row) in (dCol, dRow), the cells on the other side are offset by (sideCol, sideRow).
+		every run of cells that is open on both sides gets an entrance in the middle, or one at each end if it's wide.
+		both clusters of a border walk it in the same direction so they always agree on where the entrances are*/
+		void Graph::addBorderEntrances(const NavGrid::Grid& grid, Cluster& cluster, int col, int row, int dCol, int dRow,
+									   int length, int sideCol, int sideRow) {
+			auto addEntrance = [&](int i) {
+				int cell = grid.index(col + i * dCol, row + i * dRow);
+				if (entranceIndex[cell] < 0) { //corners can be on two borders
+					entranceIndex[cell] = (int) cluster.entrances.size();
+					cluster.entrances.push_back(cell);
+				}
+			};
+
+			int runStart = -1;
+			for (int i = 0; i <= length; i++) {
+				int cellCol = col + i * dCol, cellRow = row + i * dRow;
+				bool open = i < length &&
+							!grid.isObstacle(grid.index(cellCol, cellRow)) &&
+							!grid.isObstacle(grid.index(cellCol + sideCol, cellRow + sideRow));
+				if (open && runStart < 0) {
+					runStart = i;
+				} else if (!open && runStart >= 0) {
+					int runEnd = i - 1;
+					if (i - runStart < MIN_ENTRANCE_WIDTH_FOR_TWO_TRANSITIONS) {
+						addEntrance((runStart + runEnd) / 2);
+					} else {
+						addEntrance(runStart);
+						addEntrance(runEnd);
+					}
+					runStart = -1;
+				}
+			}
+		}
+
+		// edges out of an entrance: the other entrances of its cluster plus the entrances right across its borders
+		void Graph::getAbstractNeighbors(const NavGrid::Grid& grid, int cell, std::vector<Edge>& neighbors) const {
+			int index = entranceIndex[cell];
+			if (index < 0) {
+				return;
+			}
+			const Cluster& cluster = clusters[clusterOf(grid, cell)];
+			neighbors.insert(neighbors.end(), cluster.edges[index].begin(), cluster.edges[index].end());
+
+			int col = grid.colOf(cell);
+			int row = grid.rowOf(cell);
+			for (const auto& dir : aStar::straightDirections) {
+				int nextCol = col + dir.first, nextRow = row + dir.second;
+				if (!grid.withinBounds(nextCol, nextRow) || cluster.contains(nextCol, nextRow)) {
+					continue;
+				}
+				int next = grid.index(nextCol, nextRow);
+				if (entranceIndex[next] >= 0) {
+					neighbors.push_back({next, grid.costs[next] + aStar::STRAIGHT_MOVEMENT_COST});
+				}
+			}
+		}
+
+		bool Graph::findPath(const NavGrid::Grid& grid, int startCell, int goalCell, aStar::SearchWorkspace& workspace,
+							 std::vector<int>& cells) const {
+			cells.clear();
+			const Cluster& startCluster = clusters[clusterOf(grid, startCell)];
+			const Cluster& goalCluster = clusters[clusterOf(grid, goalCell)];
+
+			// hook the start and goal up to the entrances of their clusters for this search only
+			std::vector<Edge> startEdges;
+			searchInCluster(grid, startCluster, startCell, -1, goalCell, workspace);
+			for (int entrance : startCluster.entrances) {
+				if (entrance != startCell && workspace.isVisited(entrance)) {
+					startEdges.push_back({entrance, workspace.gScore(entrance)});
+				}
+			}
+			if (workspace.isVisited(goalCell) && goalCell != startCell) { //same cluster, might not need the graph at all
+				startEdges.push_back({goalCell, workspace.gScore(goalCell)});
+			}
+
+			// searched backwards from the goal, a path costs the cells it enters so swap the cost of the ends over
+			std::vector<Edge> goalEdges;
+			searchInCluster(grid, goalCluster, goalCell, -1, goalCell, workspace);
+			for (int entrance : goalCluster.entrances) {
+				if (entrance != goalCell && workspace.isVisited(entrance)) {
+					goalEdges.push_back({entrance, workspace.gScore(entrance) - grid.costs[entrance] + grid.costs[goalCell]});
+				}
+			}
+
+			// A* over the entrances
+			workspace.beginSearch(grid.cellCount());
+			std::vector<aStar::FrontierNode>& frontier = workspace.frontier;
+			std::vector<Edge> neighbors;
+			workspace.visit(startCell, 0, startCell);
+			frontier.push_back({(float) aStar::octileDistance(grid, startCell, goalCell), startCell});
+
+			bool found = false;
+			while (!frontier.empty()) {
+				std::pop_heap(frontier.begin(), frontier.end(), aStar::aStarComparator());
+				aStar::FrontierNode current = frontier.back();
+				frontier.pop_back();
+
+				if (current.cell == goalCell) {
+					found = true;
+					break;
+				}
+
+				int currentGScore = workspace.gScore(current.cell);
+				if (current.fScore > currentGScore + aStar::octileDistance(grid, current.cell, goalCell)) {
+					continue; //stale entry
+				}
+
+				neighbors.clear();
+				if (current.cell == startCell) {
+					neighbors = startEdges;
+				}
+				getAbstractNeighbors(grid, current.cell, neighbors);
+				for (const Edge& edge : goalEdges) {
+					if (edge.cell == current.cell) {
+						neighbors.push_back({goalCell, edge.cost});
+					}
+				}
+
+				for (const Edge& next : neighbors) {
+					int gScore = currentGScore + next.cost;
+					if (!workspace.isVisited(next.cell) || gScore < workspace.gScore(next.cell)) {
+						workspace.visit(next.cell, gScore, current.cell);
+						frontier.push_back({float(gScore + aStar::octileDistance(grid, next.cell, goalCell)), next.cell});
+						std::push_heap(frontier.begin(), frontier.end(), aStar::aStarComparator());
+					}
+				}
+			}
+			if (!found) {
+				return false;
+			}
+
+			std::vector<int> waypoints;
+			for (int current = goalCell; current != startCell; current = workspace.parent(current)) {
+				waypoints.push_back(current);
+			}
+			waypoints.push_back(startCell);
+			std::reverse(waypoints.begin(), waypoints.end());
+
+			// refine each hop, they are either a single step over a border or a search inside one cluster
+			cells.push_back(startCell);
+			for (size_t i = 1; i < waypoints.size(); i++) {
+				int from = waypoints[i - 1], to = waypoints[i];
+				int cluster = clusterOf(grid, from);
+				if (cluster != clusterOf(grid, to)) {
+					cells.push_back(to);
+					continue;
+				}
+
+				if (!searchInCluster(grid, clusters[cluster], from, to, goalCell, workspace)) {
+					cells.clear();
+					return false; //can't happen unless the graph is out of date
+				}
+				size_t hopStart = cells.size();
+				for (int current = to; current != from; current = workspace.parent(current)) {
+					cells.push_back(current);
+				}
+				std::reverse(cells.begin() + hopStart, cells.end());
+			}
+			return true;
+		}
+	}
+}
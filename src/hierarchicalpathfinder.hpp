@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include "navgrid.hpp"
+#include "pathfinder.hpp"
+
+/* HPA* (Botea, Mueller and Schaeffer 2004). the level is cut into square clusters and every open stretch of a cluster border
+gets one or two entrance cells on each side. entrances of the same cluster are linked with the real cost of walking between them,
+which gives a small abstract graph that long searches run over first. only the hops on the abstract path are then refined with
+searches that never leave a single cluster. placing a building only rebuilds the clusters around it*/
+namespace AI {
+	namespace hierarchical {
+		const int CLUSTER_SIZE = 16;
+		const int MIN_ENTRANCE_WIDTH_FOR_TWO_TRANSITIONS = 6; //narrower stretches of border get a single entrance in the middle
+
+		struct Edge {
+			int cell;
+			int cost;
+		};
+
+		struct Cluster {
+			int minCol, minRow, maxCol, maxRow; //inclusive
+			std::vector<int> entrances; //cells on the border of this cluster
+			std::vector<std::vector<Edge>> edges; //edges[i] go from entrances[i] to the other entrances it can reach inside the cluster
+
+			bool contains(int col, int row) const {
+				return col >= minCol && col <= maxCol && row >= minRow && row <= maxRow;
+			}
+		};
+
+		class Graph {
+		public:
+			// builds every cluster, call whenever the whole grid is replaced
+			void build(const NavGrid::Grid& grid);
+
+			// rebuilds the clusters whose cells or borders overlap the (inclusive) area, after the grid costs there changed
+			void updateArea(const NavGrid::Grid& grid, int minCol, int minRow, int maxCol, int maxRow);
+
+			int clusterOf(const NavGrid::Grid& grid, int cell) const;
+
+			// true if the two cells are in the same or in touching clusters, the abstract graph doesn't save anything there
+			bool isLocal(const NavGrid::Grid& grid, int cell, int otherCell) const;
+
+			/* searches the abstract graph and refines it into every cell from startCell to goalCell (both included).
+			paths are within a few percent of optimal but not always optimal. returns false if the goal can't be reached*/
+			bool findPath(const NavGrid::Grid& grid, int startCell, int goalCell, aStar::SearchWorkspace& workspace,
+						  std::vector<int>& cells) const;
+
+			int entranceCount() const;
+
+		private:
+			int clustersWide = 0;
+			int clustersHigh = 0;
+			std::vector<Cluster> clusters;
+			std::vector<int> entranceIndex; //per cell, index into its cluster's entrances or -1
+
+			void rebuildCluster(const NavGrid::Grid& grid, int cluster, aStar::SearchWorkspace& workspace);
+
+			void addBorderEntrances(const NavGrid::Grid& grid, Cluster& cluster, int col, int row, int dCol, int dRow,
+									int length, int sideCol, int sideRow);
+
+			void getAbstractNeighbors(const NavGrid::Grid& grid, int cell, std::vector<Edge>& neighbors) const;
+		};
+
+		extern Graph graph;
+	}
+}
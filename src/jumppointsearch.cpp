@@ -0,0 +1,216 @@
+#include "jumppointsearch.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace AI {
+	namespace jumpPoint {
+		int lowestSetBit(uint64_t word) {
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward64(&index, word);
+			return (int) index;
+#else
+			return __builtin_ctzll(word);
+#endif
+		}
+
+		int highestSetBit(uint64_t word) {
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanReverse64(&index, word);
+			return (int) index;
+#else
+			return 63 - __builtin_clzll(word);
+#endif
+		}
+
+		int sign(int value) {
+			return (value > 0) - (value < 0);
+		}
+
+		/* one orientation of the obstacle bitsets. for rows a line is a row and a position is a column,
+		for the transposed bitset it is the other way around. that way the same scan does both the
+		horizontal and the vertical jumps*/
+		struct BitLines {
+			const uint64_t* bits;
+			int wordsPerLine;
+			int lineCount;
+			int goalLine, goalPos; //the goal always counts as open, even when it's a building
+
+			uint64_t blocked(int line, int word) const {
+				if (line < 0 || line >= lineCount || word < 0 || word >= wordsPerLine) {
+					return ~uint64_t(0); //off the map
+				}
+				uint64_t bits = this->bits[line * wordsPerLine + word];
+				if (line == goalLine && goalPos / 64 == word) {
+					bits &= ~(uint64_t(1) << (goalPos % 64));
+				}
+				return bits;
+			}
+
+			uint64_t goalBit(int line, int word) const {
+				return line == goalLine && goalPos / 64 == word ? uint64_t(1) << (goalPos % 64) : 0;
+			}
+		};
+
+		/* scans along a line from pos (exclusive) in dir and returns the first position that is a jump point: the goal, or a cell
+		with a forced neighbour (a side cell that opens up right after being blocked, so a path might turn into it).
+		returns -1 if an obstacle or the edge of the map comes first*/
+		int jumpStraight(const BitLines& lines, int line, int pos, int dir) {
+			int start = pos + dir;
+			if (start < 0) {
+				return -1;
+			}
+
+			for (int word = start / 64; word >= 0 && word < lines.wordsPerLine; word += dir) {
+				uint64_t here = lines.blocked(line, word);
+				uint64_t events = here | lines.goalBit(line, word);
+				for (int side : {line - 1, line + 1}) {
+					uint64_t sideBits = lines.blocked(side, word);
+					//bit i of behind is whether the side cell we just walked past (i - dir) is blocked
+					uint64_t behind = dir > 0 ?
+									  (sideBits << 1) | (lines.blocked(side, word - 1) >> 63) :
+									  (sideBits >> 1) | (lines.blocked(side, word + 1) << 63);
+					events |= ~sideBits & behind;
+				}
+
+				if (word == start / 64) { //ignore everything behind the start
+					int offset = start % 64;
+					events &= dir > 0 ? ~uint64_t(0) << offset : ~uint64_t(0) >> (63 - offset);
+				}
+
+				if (events) {
+					int bit = dir > 0 ? lowestSetBit(events) : highestSetBit(events);
+					if (here & (uint64_t(1) << bit)) {
+						return -1;
+					}
+					return word * 64 + bit;
+				}
+			}
+			return -1;
+		}
+
+		struct Jumper {
+			const NavGrid::Grid& grid;
+			int goalCell;
+			BitLines rows, cols;
+
+			Jumper(const NavGrid::Grid& grid, int goalCell) :
+					grid(grid),
+					goalCell(goalCell),
+					rows{grid.blockedByRow.data(), grid.wordsPerRow, grid.height, grid.rowOf(goalCell), grid.colOf(goalCell)},
+					cols{grid.blockedByCol.data(), grid.wordsPerCol, grid.width, grid.colOf(goalCell), grid.rowOf(goalCell)} {}
+
+			bool isOpen(int col, int row) const {
+				if (!grid.withinBounds(col, row)) {
+					return false;
+				}
+				int cell = grid.index(col, row);
+				return cell == goalCell || !grid.isObstacle(cell);
+			}
+
+			// returns the cell of the next jump point from (col, row) heading in (dCol, dRow), or -1 if there is none
+			int jump(int col, int row, int dCol, int dRow) const {
+				if (dRow == 0) {
+					int jumpCol = jumpStraight(rows, row, col, dCol);
+					return jumpCol < 0 ? -1 : grid.index(jumpCol, row);
+				}
+				if (dCol == 0) {
+					int jumpRow = jumpStraight(cols, col, row, dRow);
+					return jumpRow < 0 ? -1 : grid.index(col, jumpRow);
+				}
+
+				while (true) {
+					//dont go thru diagonal corners
+					if (!isOpen(col + dCol, row) || !isOpen(col, row + dRow) || !isOpen(col + dCol, row + dRow)) {
+						return -1;
+					}
+					col += dCol;
+					row += dRow;
+					int cell = grid.index(col, row);
+					//a diagonal cell is a jump point if either of its straight jumps finds something
+					if (cell == goalCell ||
+						jumpStraight(rows, row, col, dCol) >= 0 ||
+						jumpStraight(cols, col, row, dRow) >= 0) {
+						return cell;
+					}
+				}
+			}
+		};
+
+		bool canSearch(const NavGrid::Grid& grid) {
+			return grid.isUniformCost();
+		}
+
+		bool search(const NavGrid::Grid& grid, int startCell, int goalCell, aStar::SearchWorkspace& workspace) {
+			Jumper jumper(grid, goalCell);
+			workspace.beginSearch(grid.cellCount());
+			std::vector<aStar::FrontierNode>& frontier = workspace.frontier;
+
+			workspace.visit(startCell, 0, startCell);
+			frontier.push_back({(float) aStar::octileDistance(grid, startCell, goalCell), startCell});
+
+			std::array<std::pair<int, int>, 8> directions;
+			while (!frontier.empty()) {
+				std::pop_heap(frontier.begin(), frontier.end(), aStar::aStarComparator());
+				aStar::FrontierNode current = frontier.back();
+				frontier.pop_back();
+
+				if (current.cell == goalCell) {
+					return true;
+				}
+
+				int currentGScore = workspace.gScore(current.cell);
+				if (current.fScore > currentGScore + aStar::octileDistance(grid, current.cell, goalCell)) {
+					continue; //stale entry
+				}
+
+				int col = grid.colOf(current.cell);
+				int row = grid.rowOf(current.cell);
+				int parent = workspace.parent(current.cell);
+				int dCol = sign(col - grid.colOf(parent));
+				int dRow = sign(row - grid.rowOf(parent));
+
+				// prune the directions worth jumping in based on how we got here
+				int directionCount = 0;
+				if (dCol == 0 && dRow == 0) { //the start, everything goes
+					for (const auto& dir : aStar::straightDirections) {
+						directions[directionCount++] = dir;
+					}
+					for (const auto& dir : aStar::diagonalDirections) {
+						directions[directionCount++] = dir;
+					}
+				} else if (dCol != 0 && dRow != 0) {
+					directions[directionCount++] = {dCol, 0};
+					directions[directionCount++] = {0, dRow};
+					directions[directionCount++] = {dCol, dRow};
+				} else {
+					//moving straight, anything to the side might have been cut off by an obstacle behind us
+					int sideCol = dRow, sideRow = dCol;
+					directions[directionCount++] = {dCol, dRow};
+					directions[directionCount++] = {sideCol, sideRow};
+					directions[directionCount++] = {-sideCol, -sideRow};
+					directions[directionCount++] = {dCol + sideCol, dRow + sideRow};
+					directions[directionCount++] = {dCol - sideCol, dRow - sideRow};
+				}
+
+				for (int i = 0; i < directionCount; i++) {
+					int next = jumper.jump(col, row, directions[i].first, directions[i].second);
+					if (next < 0) {
+						continue;
+					}
+
+					int gScore = currentGScore + aStar::octileDistance(grid, current.cell, next);
+					if (!workspace.isVisited(next) || gScore < workspace.gScore(next)) {
+						workspace.visit(next, gScore, current.cell);
+						frontier.push_back({float(gScore + aStar::octileDistance(grid, next, goalCell)), next});
+						std::push_heap(frontier.begin(), frontier.end(), aStar::aStarComparator());
+					}
+				}
+			}
+			return false;
+		}
+	}
+}
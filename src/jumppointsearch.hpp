@@ -0,0 +1,20 @@
+#pragma once
+
+#include "navgrid.hpp"
+#include "pathfinder.hpp"
+
+/* Jump point search for 8-connected uniform cost grids (see Harabor and Grastien 2011).
+instead of pushing every neighbour it jumps along straight and diagonal lines and only pushes the cells
+where the optimal path could turn, so open areas collapse into a handful of nodes.
+straight jumps scan a whole 64 cell word of NavGrid's obstacle bitsets at a time.
+diagonals never squeeze between two obstacles, same as getNeighbors in A* */
+namespace AI {
+	namespace jumpPoint {
+		// jump point search only gives optimal paths when every open cell costs the same
+		bool canSearch(const NavGrid::Grid& grid);
+
+		// fills the workspace parents with jump points from goalCell back to startCell, returns false if the goal can't be
+		// reached. consecutive jump points are always on a straight or diagonal line (reconstruct_path fills in the gaps)
+		bool search(const NavGrid::Grid& grid, int startCell, int goalCell, aStar::SearchWorkspace& workspace);
+	}
+}
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include "landmarks.hpp"
+#include "pathfinder.hpp" //for movement costs
+#include "common.hpp" //for logger
+
+namespace AI {
+	namespace landmarks {
+		Landmarks landmarks;
+
+		bool isOpen(const NavGrid::Grid& grid, int col, int row) {
+			return grid.withinBounds(col, row) && !grid.isObstacle(grid.index(col, row));
+		}
+
+		/* dijkstra out of source (or into it when reverse is set) with the same moves and costs as A*.
+		obstacles can be where a path ends (or starts, going in reverse) but nothing walks through them*/
+		void fillDistances(const NavGrid::Grid& grid, int source, bool reverse, std::vector<int>& distances) {
+			distances.assign(grid.cellCount(), UNREACHED);
+			std::vector<std::pair<int, int>> frontier; //min heap of (distance, cell)
+			distances[source] = 0;
+			frontier.emplace_back(0, source);
+
+			while (!frontier.empty()) {
+				std::pop_heap(frontier.begin(), frontier.end(), std::greater<std::pair<int, int>>());
+				std::pair<int, int> current = frontier.back();
+				frontier.pop_back();
+
+				int cell = current.second;
+				if (current.first > distances[cell]) {
+					continue;
+				}
+
+				int col = grid.colOf(cell), row = grid.rowOf(cell);
+				for (int dRow = -1; dRow <= 1; dRow++) {
+					for (int dCol = -1; dCol <= 1; dCol++) {
+						int nextCol = col + dCol, nextRow = row + dRow;
+						if ((dCol == 0 && dRow == 0) || !grid.withinBounds(nextCol, nextRow)) {
+							continue;
+						}
+						bool diagonal = dCol != 0 && dRow != 0;
+						//dont go thru diagonal corners
+						if (diagonal && (!isOpen(grid, nextCol, row) || !isOpen(grid, col, nextRow))) {
+							continue;
+						}
+
+						int next = grid.index(nextCol, nextRow);
+						int entered = reverse ? cell : next; //steps cost what the cell being stepped onto costs
+						int distance = current.first + grid.costs[entered] +
+									   (diagonal ? aStar::DIAGONAL_MOVEMENT_COST : aStar::STRAIGHT_MOVEMENT_COST);
+						if (distances[next] == UNREACHED || distance < distances[next]) {
+							distances[next] = distance;
+							if (!grid.isObstacle(next)) { //obstacles are dead ends, no need to queue them
+								frontier.emplace_back(distance, next);
+								std::push_heap(frontier.begin(), frontier.end(), std::greater<std::pair<int, int>>());
+							}
+						}
+					}
+				}
+			}
+		}
+
+		std::shared_ptr<const Table> buildTable(const NavGrid::Grid& grid, int cell) {
+			std::shared_ptr<Table> table = std::make_shared<Table>();
+			table->cell = cell;
+			table->version = grid.version;
+			fillDistances(grid, cell, false, table->fromLandmark);
+			fillDistances(grid, cell, true, table->toLandmark);
+			return table;
+		}
+
+		void Landmarks::build(const NavGrid::Grid& grid, int count) {
+			pending.reset(); //waits for it to finish
+			slots.clear();
+			count = std::min(count, MAX_LANDMARKS);
+
+			//start from the open cell closest to the middle, the first landmark is whatever is furthest from there
+			int seed = -1, seedDistance = 0;
+			for (int cell = 0; cell < grid.cellCount(); cell++) {
+				int colDiff = grid.colOf(cell) - grid.width / 2, rowDiff = grid.rowOf(cell) - grid.height / 2;
+				int distance = colDiff * colDiff + rowDiff * rowDiff;
+				if (!grid.isObstacle(cell) && (seed < 0 || distance < seedDistance)) {
+					seed = cell;
+					seedDistance = distance;
+				}
+			}
+			if (seed < 0) {
+				return; //nothing open
+			}
+
+			// every following landmark goes where the cost from the closest landmark picked so far is the highest
+			std::vector<int> closest;
+			fillDistances(grid, seed, false, closest);
+			while ((int) slots.size() < count) {
+				int next = -1;
+				for (int cell = 0; cell < grid.cellCount(); cell++) {
+					if (!grid.isObstacle(cell) && closest[cell] > 0 && (next < 0 || closest[cell] > closest[next])) {
+						next = cell;
+					}
+				}
+				if (next < 0) {
+					break; //every open cell we can get to is a landmark already
+				}
+
+				slots.push_back({buildTable(grid, next), true});
+				const std::vector<int>& distances = slots.back().table->fromLandmark;
+				for (int cell = 0; cell < grid.cellCount(); cell++) {
+					if (closest[cell] != UNREACHED) {
+						closest[cell] = std::min(closest[cell], distances[cell]);
+					}
+				}
+			}
+			logger(LogLevel::INFO) << "Built " << slots.size() << " landmarks using " << memoryUsage() / 1024 << " KB\n";
+		}
+
+		void Landmarks::updateArea(const NavGrid::Grid& grid, bool lowered) {
+			if (lowered) {
+				loweredChanges++;
+				for (Slot& slot : slots) {
+					slot.usable = false; //could overestimate now, a cheaper way might go through the area
+				}
+			}
+		}
+
+		void Landmarks::repair(const NavGrid::Grid& grid, bool wait) {
+			while (true) {
+				if (pending) {
+					if (!wait && pending->table.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+						return;
+					}
+					//anything that only got more expensive since it started still leaves it a lower bound
+					slots[pending->slot] = {pending->table.get(), pending->loweredChanges == loweredChanges};
+					pending.reset();
+				}
+
+				int next = -1;
+				for (int i = 0; i < (int) slots.size(); i++) {
+					if (slots[i].table->version != grid.version && (next < 0 || (!slots[i].usable && slots[next].usable))) {
+						next = i;
+					}
+				}
+				if (next < 0) {
+					return;
+				}
+				std::shared_ptr<const NavGrid::Grid> copy = std::make_shared<const NavGrid::Grid>(grid);
+				int cell = slots[next].table->cell;
+				pending = std::make_shared<PendingTable>();
+				pending->slot = next;
+				pending->loweredChanges = loweredChanges;
+				pending->table = std::async(std::launch::async, [copy, cell] { return buildTable(*copy, cell); });
+				if (!wait) {
+					return;
+				}
+			}
+		}
+
+		int Landmarks::staleCount(const NavGrid::Grid& grid) const {
+			int stale = 0;
+			for (const Slot& slot : slots) {
+				stale += slot.table->version != grid.version;
+			}
+			return stale;
+		}
+
+		size_t Landmarks::memoryUsage() const {
+			size_t bytes = 0;
+			for (const Slot& slot : slots) {
+				bytes += sizeof(Table) + sizeof(int) * (slot.table->fromLandmark.capacity() + slot.table->toLandmark.capacity());
+			}
+			return bytes;
+		}
+
+		Estimate::Estimate(const NavGrid::Grid& grid, const Landmarks& landmarks, int goalCell) :
+				grid(grid), goalCell(goalCell), goalIsOpen(!grid.isObstacle(goalCell)) {
+			for (const Landmarks::Slot& slot : landmarks.slots) {
+				const Table& table = *slot.table;
+				if (slot.usable && (int) table.fromLandmark.size() == grid.cellCount()) {
+					tables[count] = &table;
+					fromLandmarkToGoal[count] = table.fromLandmark[goalCell];
+					fromGoalToLandmark[count] = table.toLandmark[goalCell];
+					count++;
+				}
+			}
+		}
+
+		/* going landmark -> cell -> goal can't beat the best way from the landmark to the goal, and going cell -> goal -> landmark
+		can't beat the best way from the cell to the landmark. the second one walks through the goal, so only if it's open*/
+		int Estimate::operator()(int cell) const {
+			int best = aStar::octileDistance(grid, cell, goalCell);
+			for (int i = 0; i < count; i++) {
+				int toCell = tables[i]->fromLandmark[cell];
+				if (fromLandmarkToGoal[i] != UNREACHED && toCell != UNREACHED) {
+					best = std::max(best, fromLandmarkToGoal[i] - toCell);
+				}
+				int fromCell = tables[i]->toLandmark[cell];
+				if (goalIsOpen && fromGoalToLandmark[i] != UNREACHED && fromCell != UNREACHED) {
+					best = std::max(best, fromCell - fromGoalToLandmark[i]);
+				}
+			}
+			return best;
+		}
+	}
+}
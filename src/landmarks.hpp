@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <vector>
+#include "navgrid.hpp"
+
+/* ALT heuristic (Goldberg and Harrelson 2005). a few landmark cells spread around the level store the real cost of walking
+from them to every cell and from every cell back to them. the triangle inequality turns two table lookups per landmark into
+a lower bound on the cost between any two cells that, unlike straight line distance, knows about walls.
+placing a building only makes walking more expensive, and old tables still give a lower bound then, so they keep being used
+and get rebuilt one at a time on a background thread afterwards. tables are only switched off when something got cheaper*/
+namespace AI {
+	namespace landmarks {
+		const int DEFAULT_LANDMARK_COUNT = 8;
+		const int MAX_LANDMARKS = 16;
+		const int UNREACHED = -1;
+
+		// distances for one landmark, never changed once built so searches on other threads can share it
+		struct Table {
+			int cell;
+			unsigned int version; //grid version it was built against
+			std::vector<int> fromLandmark; //cost of walking from the landmark to each cell, UNREACHED if it can't
+			std::vector<int> toLandmark; //cost of walking from each cell to the landmark
+		};
+
+		class Landmarks {
+		public:
+			// picks count landmarks as far from each other as possible and builds their tables
+			void build(const NavGrid::Grid& grid, int count = DEFAULT_LANDMARK_COUNT);
+
+			// call after the costs in the area changed, lowered is true if any cost there went down
+			void updateArea(const NavGrid::Grid& grid, bool lowered);
+
+			/* call once per tick on the main thread. swaps in the table rebuilt in the background once it's done and starts
+			on the next out of date one, the ones that stopped being usable first. wait blocks until every table is current*/
+			void repair(const NavGrid::Grid& grid, bool wait = false);
+
+			int landmarkCount() const {
+				return (int) slots.size();
+			}
+
+			int staleCount(const NavGrid::Grid& grid) const;
+
+			// bytes held by the distance tables
+			size_t memoryUsage() const;
+
+		private:
+			friend class Estimate;
+
+			struct Slot {
+				std::shared_ptr<const Table> table;
+				bool usable; //false once a cost went down after the table was built
+			};
+
+			struct PendingTable {
+				int slot;
+				int loweredChanges; //loweredChanges when the rebuild started
+				std::future<std::shared_ptr<const Table>> table;
+			};
+
+			std::vector<Slot> slots;
+			int loweredChanges = 0; //updateArea calls that lowered a cost
+			std::shared_ptr<PendingTable> pending; //shared so copies of the level can still be taken while it runs
+		};
+
+		/* the lower bound towards one goal. the goal's own distances are looked up once when a search starts, after that
+		every estimate is a couple of lookups per landmark. never less than the octile distance*/
+		class Estimate {
+		public:
+			Estimate(const NavGrid::Grid& grid, const Landmarks& landmarks, int goalCell);
+
+			int operator()(int cell) const;
+
+		private:
+			const NavGrid::Grid& grid;
+			int goalCell;
+			int count = 0;
+			bool goalIsOpen;
+			std::array<const Table*, MAX_LANDMARKS> tables;
+			std::array<int, MAX_LANDMARKS> fromLandmarkToGoal;
+			std::array<int, MAX_LANDMARKS> fromGoalToLandmark;
+		};
+
+		extern Landmarks landmarks;
+	}
+}
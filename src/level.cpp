@@ -1,12 +1,16 @@
+#include <algorithm>
 #include <iostream>
 #include "global.hpp"
 #include "level.hpp"
 #include "logger.hpp"
 #include "particle.hpp"
 #include "coord.hpp"
+#include "navgrid.hpp"
+
+const unsigned Level::GROUND, Level::OBSTACLES;
 
 //int is used as movement cost
-std::map<Model::MeshType, int> Level::tileToCost{
+const std::map<Model::MeshType, int> Level::tileToCost{
 		{Model::MeshType::HROAD,      Config::OBSTACLE_COST           },
 		{Model::MeshType::SAND_1,     Config::DEFAULT_TRAVERSABLE_COST},
 		{Model::MeshType::SAND_2,     Config::DEFAULT_TRAVERSABLE_COST},
@@ -47,6 +51,7 @@ std::map<char, Model::MeshType> Level::charToType{
 bool Level::init(const std::vector<std::shared_ptr<Renderer>>& meshRenderers) {
 	// So that re initializing will be the same as first initialization
 	tiles.clear();
+	staticGeometry.clear();
 
 	for (size_t i = 0; i < Global::levelArray.size(); i++) {
 		std::vector<Model::MeshType> row = Global::levelArray[i];
@@ -57,6 +62,7 @@ bool Level::init(const std::vector<std::shared_ptr<Renderer>>& meshRenderers) {
             tilePointer->setPosition({ j, 0, i });
 			tilePointer->position = { j, 0, i };	// Because the tile needs its position on its own as well
             tiles.push_back(tilePointer);
+			addToStaticGeometry((int) tiles.size() - 1);
 		}
 	}
 	tileCursor = std::make_shared<Tile>(Model::MeshType::TILE_CURSOR);
@@ -87,9 +93,12 @@ void Level::save(std::string filename)
 
 void Level::update(float ms)
 {
-    for (auto& tile : tiles) {
-		tile->update(ms);
-    }
+	for (int i = 0; i < (int) tiles.size(); i++) {
+		tiles[i]->update(ms);
+		if (tiles[i]->isDeleted) {
+			staticGeometry.remove(i); //destroyed buildings, placeTile takes out what it replaces itself
+		}
+	}
 
 	Global::levelWithUnitsTraversalCostMap = Global::levelTraversalCostMap;
 }
@@ -115,11 +124,13 @@ std::vector<std::vector<Model::MeshType>> Level::levelLoader(const std::string&
 			if (charToType.find(tile) == charToType.end()) {
 				// Not in map
 				row.push_back(Model::MeshType::SAND_2);
-				tileData.push_back(tileToCost[Model::MeshType::SAND_2]);
+				tileData.push_back(tileToCost.at(Model::MeshType::SAND_2));
 			}
 			else {
 				row.push_back(charToType[tile]);
-				tileData.push_back(tileToCost[charToType[tile]]);
+				//buildings have no cost, looking them up mustn't add one or they'd be filed as ground
+				auto cost = tileToCost.find(charToType[tile]);
+				tileData.push_back(cost == tileToCost.end() ? 0 : cost->second);
 			}
 			colNumber++;
 		}
@@ -156,6 +167,16 @@ inline bool tilesOverlap(glm::vec3 locA, glm::vec3 sizeA, glm::vec3 locB, glm::v
 	return true;
 }
 
+// the area of the world a tile covers, overlapping the same tiles as tilesOverlap does. locations are the tile's top
+// left cell and cells are centred on whole coordinates
+BoundingBox tileBox(glm::vec3 location, glm::vec3 size) {
+	int lowerCornerX = location.x;
+	int lowerCornerZ = location.z - size.z;
+	int upperCornerX = location.x + size.x;
+	int upperCornerZ = location.z;
+	return { { lowerCornerX - 0.5f, 0, lowerCornerZ + 0.5f }, { upperCornerX - 0.5f, 0, upperCornerZ + 0.5f } };
+}
+
 void printLevelCostMap() {
 	for (const auto& row: Global::levelTraversalCostMap) {
 		for (const auto& cellCost : row) {
@@ -176,25 +197,26 @@ std::shared_ptr<Tile> Level::placeTile(Model::MeshType type, glm::vec3 location,
 {
 	// Update graphics
 	glm::vec3 size = { width, 0, height };
-	for (auto& tile : tiles) {
-		if(!tile->isDeleted && tilesOverlap(tile->position, tile->size, location, size)) {
-			// Get rid of old tile
-			tile->removeSelf();
-
-			// Handle case in which we would end up with empty tiles
-			int minX = tile->position.x;
-			int maxX = (tile->position + tile->size).x;
-			int minZ = (tile->position - tile->size).z;
-			int maxZ = tile->position.z;
-			for (int x = minX; x < maxX; x++) {
-				for (int z = maxZ; z > minZ; z--) {
-					if (!tilesOverlap({ x,0,z }, { 1,0,1 }, location, size)) {
-						placeTile(replacingMesh, { x, 0, z }, GamePieceOwner::NONE); //FIXME: recursive? also never get called
-					}
+	std::vector<int> replaced = tilesInArea(location, size); //placing the replacements below overwrites found
+	for (int index : replaced) {
+		std::shared_ptr<Tile> tile = tiles[index];
+		// Get rid of old tile
+		tile->removeSelf();
+		staticGeometry.remove(index);
+
+		// Handle case in which we would end up with empty tiles
+		int minX = tile->position.x;
+		int maxX = (tile->position + tile->size).x;
+		int minZ = (tile->position - tile->size).z;
+		int maxZ = tile->position.z;
+		for (int x = minX; x < maxX; x++) {
+			for (int z = maxZ; z > minZ; z--) {
+				if (!tilesOverlap({ x,0,z }, { 1,0,1 }, location, size)) {
+					placeTile(replacingMesh, { x, 0, z }, GamePieceOwner::NONE); //FIXME: recursive? also never get called
 				}
 			}
-			// TODO: Actually remove the tiles lol (memory is still allocated)
 		}
+		// TODO: Actually remove the tiles lol (memory is still allocated)
 	}
 
 	// Update level cost map
@@ -205,6 +227,8 @@ std::shared_ptr<Tile> Level::placeTile(Model::MeshType type, glm::vec3 location,
 			Global::levelTraversalCostMap[z][x] = Config::OBSTACLE_COST;
 		}
 	}
+	AI::NavGrid::updateArea(locationInt.colCoord, locationInt.rowCoord - (int) height + 1,
+							locationInt.colCoord + (int) width - 1, locationInt.rowCoord);
 
 	std::shared_ptr<Tile> newTile = tileFromMeshType(type, extraArg);
 	newTile->setPosition(location);
@@ -212,29 +236,22 @@ std::shared_ptr<Tile> Level::placeTile(Model::MeshType type, glm::vec3 location,
 	newTile->size = size;
 	setupAiCompForTile(newTile, owner);
 	tiles.push_back(newTile);
+	addToStaticGeometry((int) tiles.size() - 1);
 	Global::buildingTileList.push_back(newTile);
 	return newTile;
 }
 
 std::shared_ptr<Tile> Level::getTileAt(glm::vec3 location)
 {
-	glm::vec3 size = { 1, 0, 1 };
-	for (auto& tile : tiles) {
-		if (!tile->isDeleted && tilesOverlap(tile->position, tile->size, location, size)) {
-			return tile;
-		}
-	}
-	return nullptr;
+	const std::vector<int>& inArea = tilesInArea(location, { 1, 0, 1 });
+	return inArea.empty() ? nullptr : tiles[inArea.front()];
 }
 
 int Level::numTilesOfTypeInArea(Model::MeshType type, glm::vec3 location, unsigned int height, unsigned int width)
 {
 	int total = 0;
-	glm::vec3 size = { width, 0, height };
-	for (auto& tile : tiles) {
-		if (!tile->isDeleted && tilesOverlap(tile->position, tile->size, location, size)) {
-			if (tile->type == type)total++;
-		}
+	for (int index : tilesInArea(location, { width, 0, height })) {
+		if (tiles[index]->type == type)total++;
 	}
 	return total;
 }
@@ -242,27 +259,41 @@ int Level::numTilesOfTypeInArea(Model::MeshType type, glm::vec3 location, unsign
 int Level::numTilesOfOwnerInArea(GamePieceOwner owner, glm::vec3 location, unsigned int height, unsigned int width)
 {
 	int total = 0;
-	glm::vec3 size = { width, 0, height };
-	for (auto& tile : tiles) {
-		if (!tile->isDeleted && tilesOverlap(tile->position, tile->size, location, size)) {
-			if (tile->aiComp.owner == owner)total++;
-		}
+	for (int index : tilesInArea(location, { width, 0, height })) {
+		if (tiles[index]->aiComp.owner == owner)total++;
 	}
 	return total;
 }
 
 bool Level::unpathableTilesInArea(glm::vec3 location, unsigned int height, unsigned int width)
 {
-	glm::vec3 size = { width, 0, height };
-	for (auto& tile : tiles) {
-		if (!tile->isDeleted && tilesOverlap(tile->position, tile->size, location, size)) {
-			int cost = tileToCost[tile->type];
-			if (cost == Config::OBSTACLE_COST)return true;
-		}
+	for (int index : tilesInArea(location, { width, 0, height }, OBSTACLES)) {
+		//buildings are in the layer too, placing over them is checked by owner instead
+		auto cost = tileToCost.find(tiles[index]->type);
+		if (cost != tileToCost.end() && cost->second == Config::OBSTACLE_COST)return true;
 	}
 	return false;
 }
 
+// buildings aren't in tileToCost, nothing walks through them
+void Level::addToStaticGeometry(int tile)
+{
+	auto cost = tileToCost.find(tiles[tile]->type);
+	bool obstacle = cost == tileToCost.end() || cost->second == Config::OBSTACLE_COST;
+	staticGeometry.insert(tile, tileBox(tiles[tile]->position, tiles[tile]->size), obstacle ? OBSTACLES : GROUND);
+}
+
+const std::vector<int>& Level::tilesInArea(glm::vec3 location, glm::vec3 size, unsigned layers)
+{
+	found.clear();
+	staticGeometry.overlapping(tileBox(location, size), found, layers);
+	found.erase(std::remove_if(found.begin(), found.end(), [this](int index) {
+		return tiles[index]->isDeleted;
+	}), found.end());
+	std::sort(found.begin(), found.end());
+	return found;
+}
+
 std::shared_ptr<Tile> Level::tileFromMeshType(Model::MeshType type, int extraArg)
 {
 	switch (type) {
@@ -9,6 +9,7 @@
 #include "tile.hpp"
 #include "model.hpp"
 #include "entity.hpp"
+#include "staticbvh.hpp"
 
 
 #define INF std::numeric_limits<float>::infinity()
@@ -25,6 +26,10 @@ public:
 	std::vector<std::shared_ptr<Tile>> tiles; // we can add the time dimension when we get there
 	std::shared_ptr<Tile> tileCursor;
 
+	// layers of staticGeometry. obstacles are what you can't walk through: buildings, trees, water, geysers
+	static const unsigned GROUND = 1, OBSTACLES = 2;
+	StaticBvh staticGeometry; //every tile still standing, by index in tiles
+
 	std::shared_ptr<Shader> particleShader;
 	std::shared_ptr<Texture> particleTexture;
 
@@ -63,12 +68,17 @@ public:
 	void setupAiCompForTile(std::shared_ptr<Tile> tile, GamePieceOwner owner);
 
 	// Indexable using MeshType enum
-	static std::map<Model::MeshType, int> tileToCost;
+	static const std::map<Model::MeshType, int> tileToCost;
 
 	static std::map<char, Model::MeshType> charToType;
 
 private:
 	//members
+	std::vector<int> found; //scratch for staticGeometry queries
 
 	//funcs
+	void addToStaticGeometry(int tile);
+
+	// the tiles overlapping the area, in the order they are in tiles
+	const std::vector<int>& tilesInArea(glm::vec3 location, glm::vec3 size, unsigned layers = StaticBvh::ALL_LAYERS);
 };
@@ -7,7 +7,7 @@
 
 namespace Model {
 	enum MeshType { //avoid enum class to avoid casting to integers
-		NONE = -1, //for pathfinding.cpp, it needs a meshtype in aStarNode
+		NONE = -1,
 
 		//level tile textures
 		SAND_1,
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include "navgrid.hpp"
+#include "global.hpp" //for the level cost map
+#include "hierarchicalpathfinder.hpp"
+#include "landmarks.hpp"
+#include "regions.hpp"
+
+namespace AI {
+	namespace NavGrid {
+		Grid grid;
+
+		void Grid::setCost(int cell, int cost) {
+			int col = colOf(cell);
+			int row = rowOf(cell);
+			bool wasObstacle = isObstacle(cell);
+			bool wasWeighted = !wasObstacle && costs[cell] != Config::DEFAULT_TRAVERSABLE_COST;
+			costs[cell] = cost;
+			bool obstacle = isObstacle(cell);
+			bool weighted = !obstacle && cost != Config::DEFAULT_TRAVERSABLE_COST;
+
+			weightedCells += int(weighted) - int(wasWeighted);
+			if (obstacle != wasObstacle) {
+				blockedByRow[row * wordsPerRow + col / 64] ^= uint64_t(1) << (col % 64);
+				blockedByCol[col * wordsPerCol + row / 64] ^= uint64_t(1) << (row % 64);
+			}
+		}
+
+		bool Grid::changesSince(unsigned int sinceVersion, std::vector<ChangedArea>& changes) const {
+			changes.clear();
+			if (sinceVersion == version) {
+				return true;
+			}
+			if (recentChanges.empty() || recentChanges.front().version > sinceVersion + 1) {
+				return false;
+			}
+			for (const ChangedArea& change : recentChanges) {
+				if (change.version > sinceVersion) {
+					changes.push_back(change);
+				}
+			}
+			return true;
+		}
+
+		const Grid* Grid::forAgentSize(int size) const {
+			if (size <= 1) {
+				return this;
+			}
+			int index = size - 2;
+			return index < (int) agentGrids.size() ? agentGrids[index].get() : nullptr;
+		}
+
+		//every cell blocked (that takes care of the padding bits), cells get opened up by setCost
+		void reset(Grid& target, int width, int height) {
+			target.width = width;
+			target.height = height;
+			target.wordsPerRow = (width + 63) / 64;
+			target.wordsPerCol = (height + 63) / 64;
+			target.costs.assign(target.cellCount(), Config::OBSTACLE_COST);
+			target.blockedByRow.assign(height * target.wordsPerRow, ~uint64_t(0));
+			target.blockedByCol.assign(width * target.wordsPerCol, ~uint64_t(0));
+			target.weightedCells = 0;
+			target.recentChanges.clear();
+			target.neighborMasks.clear();
+			target.agentGrids.clear();
+		}
+
+		// recomputes the neighbour masks of every cell next to or inside the (inclusive) area, a cell's mask only
+		// depends on the eight cells around it
+		void updateNeighborMasks(Grid& target, int minCol, int minRow, int maxCol, int maxRow) {
+			if ((int) target.neighborMasks.size() != target.cellCount()) {
+				target.neighborMasks.assign(target.cellCount(), 0);
+			}
+			auto isOpen = [&](int col, int row) {
+				return target.withinBounds(col, row) && !target.isObstacle(target.index(col, row));
+			};
+			for (int row = std::max(minRow - 1, 0); row <= std::min(maxRow + 1, target.height - 1); row++) {
+				for (int col = std::max(minCol - 1, 0); col <= std::min(maxCol + 1, target.width - 1); col++) {
+					uint8_t mask = 0;
+					for (int i = 0; i < (int) neighborDirections.size(); i++) {
+						int nextCol = col + neighborDirections[i].first, nextRow = row + neighborDirections[i].second;
+						//dont go thru diagonal corners. a straight move's "corners" are the two cells themselves, and this
+						//one doesn't have to be open
+						bool straight = i < 4;
+						if (isOpen(nextCol, nextRow) && (straight || (isOpen(nextCol, row) && isOpen(col, nextRow)))) {
+							mask |= uint8_t(1) << i;
+						}
+					}
+					target.neighborMasks[target.index(col, row)] = mask;
+				}
+			}
+		}
+
+		// recomputes the clearance of every cell whose square could reach into the (inclusive) area.
+		// a cell's clearance only depends on the cells right, below and diagonally below right of it, so going backwards works
+		void updateClearance(Grid& target, int minCol, int minRow, int maxCol, int maxRow) {
+			auto at = [&](int col, int row) {
+				return target.withinBounds(col, row) ? target.clearance[target.index(col, row)] : 0;
+			};
+			for (int row = maxRow; row >= std::max(minRow - MAX_AGENT_SIZE + 1, 0); row--) {
+				for (int col = maxCol; col >= std::max(minCol - MAX_AGENT_SIZE + 1, 0); col--) {
+					int cell = target.index(col, row);
+					int clearance = 0;
+					if (!target.isObstacle(cell)) {
+						clearance = std::min(1 + std::min({at(col + 1, row), at(col, row + 1), at(col + 1, row + 1)}),
+											 MAX_AGENT_SIZE);
+					}
+					target.clearance[cell] = (uint8_t) clearance;
+				}
+			}
+		}
+
+		void buildAgentGrid(const Grid& level, int size, Grid& target) {
+			reset(target, level.width, level.height);
+			target.version = level.version;
+			for (int cell = 0; cell < level.cellCount(); cell++) {
+				target.setCost(cell, level.clearance[cell] >= size ? level.costs[cell] : Config::OBSTACLE_COST);
+			}
+			updateNeighborMasks(target, 0, 0, target.width - 1, target.height - 1);
+			regions::build(target);
+		}
+
+		const Grid& agentGrid(int size) {
+			size = std::min(size, MAX_AGENT_SIZE);
+			if (size <= 1) {
+				return grid;
+			}
+			if ((int) grid.agentGrids.size() < size - 1) {
+				grid.agentGrids.resize(size - 1);
+			}
+			std::shared_ptr<const Grid>& agentGrid = grid.agentGrids[size - 2];
+			if (!agentGrid) {
+				std::shared_ptr<Grid> built = std::make_shared<Grid>();
+				buildAgentGrid(grid, size, *built);
+				agentGrid = built;
+			}
+			return *agentGrid;
+		}
+
+		void init(const std::vector<std::vector<int>>& costMap) {
+			int height = (int) costMap.size();
+			reset(grid, costMap.empty() ? 0 : (int) costMap.front().size(), height);
+			for (int row = 0; row < grid.height; row++) {
+				//rows can be ragged if the level file is, anything missing is treated as an obstacle
+				int rowWidth = std::min(grid.width, (int) costMap[row].size());
+				for (int col = 0; col < rowWidth; col++) {
+					grid.setCost(grid.index(col, row), costMap[row][col]);
+				}
+			}
+			grid.version++;
+			updateNeighborMasks(grid, 0, 0, grid.width - 1, grid.height - 1);
+			grid.clearance.assign(grid.cellCount(), 0);
+			updateClearance(grid, 0, 0, grid.width - 1, grid.height - 1);
+			regions::build(grid);
+			hierarchical::graph.build(grid);
+			landmarks::landmarks.build(grid);
+		}
+
+		void pushChange(Grid& target, int minCol, int minRow, int maxCol, int maxRow) {
+			target.recentChanges.push_back({target.version, minCol, minRow, maxCol, maxRow});
+			if ((int) target.recentChanges.size() > MAX_RECENT_CHANGES) {
+				target.recentChanges.pop_front();
+			}
+		}
+
+		void updateArea(int minCol, int minRow, int maxCol, int maxRow) {
+			minCol = std::max(minCol, 0);
+			minRow = std::max(minRow, 0);
+			maxCol = std::min(maxCol, grid.width - 1);
+			maxRow = std::min(maxRow, grid.height - 1);
+			if (minCol > maxCol || minRow > maxRow) {
+				return;
+			}
+
+			bool lowered = false;
+			for (int row = minRow; row <= maxRow; row++) {
+				for (int col = minCol; col <= maxCol; col++) {
+					int cell = grid.index(col, row);
+					lowered |= Global::levelTraversalCostMap[row][col] < grid.costs[cell];
+					grid.setCost(cell, Global::levelTraversalCostMap[row][col]);
+				}
+			}
+			grid.version++;
+			pushChange(grid, minCol, minRow, maxCol, maxRow);
+			updateNeighborMasks(grid, minCol, minRow, maxCol, maxRow);
+			updateClearance(grid, minCol, minRow, maxCol, maxRow);
+			regions::updateArea(grid, minCol, minRow, maxCol, maxRow);
+			hierarchical::graph.updateArea(grid, minCol, minRow, maxCol, maxRow);
+			landmarks::landmarks.updateArea(grid, lowered);
+
+			//agent grids can be held by searches on other threads, so changed ones are copies
+			for (int i = 0; i < (int) grid.agentGrids.size(); i++) {
+				if (!grid.agentGrids[i]) {
+					continue;
+				}
+				int size = i + 2;
+				int agentMinCol = std::max(minCol - size + 1, 0), agentMinRow = std::max(minRow - size + 1, 0);
+				std::shared_ptr<Grid> agentGrid = std::make_shared<Grid>(*grid.agentGrids[i]);
+				for (int row = agentMinRow; row <= maxRow; row++) {
+					for (int col = agentMinCol; col <= maxCol; col++) {
+						int cell = grid.index(col, row);
+						agentGrid->setCost(cell, grid.clearance[cell] >= size ? grid.costs[cell] : Config::OBSTACLE_COST);
+					}
+				}
+				agentGrid->version = grid.version;
+				pushChange(*agentGrid, agentMinCol, agentMinRow, maxCol, maxRow);
+				updateNeighborMasks(*agentGrid, agentMinCol, agentMinRow, maxCol, maxRow);
+				regions::updateArea(*agentGrid, agentMinCol, agentMinRow, maxCol, maxRow);
+				grid.agentGrids[i] = agentGrid;
+			}
+		}
+	}
+}
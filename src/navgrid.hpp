@@ -0,0 +1,167 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "config.hpp"
+
+namespace AI {
+	namespace NavGrid {
+		const int MAX_RECENT_CHANGES = 64;
+		const int MAX_AGENT_SIZE = 4; //clearance is capped here, nothing wider than this can be searched for
+
+		// the 8 moves out of a cell in (col, row) deltas, straight ones first. same order as aStar's straightDirections
+		// followed by its diagonalDirections, bit i of a neighbour mask is the move neighborDirections[i]
+		constexpr std::array<std::pair<int, int>, 8> neighborDirections = {{
+				{0, 1}, {0, -1}, {1, 0}, {-1, 0}, //straight
+				{1, 1}, {-1, 1}, {1, -1}, {-1, -1}, //diagonal
+				}};
+
+		// the move that undoes move i
+		inline int oppositeDirection(int i) {
+			return i < 4 ? i ^ 1 : 11 - i;
+		}
+
+		struct ChangedArea {
+			unsigned int version; //grid version right after the change
+			int minCol, minRow, maxCol, maxRow; //inclusive
+		};
+
+		// flat, row major copy of Global::levelTraversalCostMap that the pathfinders read from
+		// cells are addressed by a single int: row * width + col
+		struct Grid {
+			int width = 0;
+			int height = 0;
+			unsigned int version = 0; //bumped every time a cost changes, lets caches know they are stale
+			std::vector<int> costs;
+
+			// one bit per cell, set for obstacles. bits past the edge of the level are set as well
+			// so scans stop at the border without bounds checks
+			int wordsPerRow = 0;
+			int wordsPerCol = 0;
+			std::vector<uint64_t> blockedByRow; //row major, bit col of word (row * wordsPerRow + col / 64)
+			std::vector<uint64_t> blockedByCol; //the same bits transposed so vertical scans are word sized too
+
+			// traversable cells that cost something other than the default, uniform cost searches
+			// (eg jump point search) are only valid while this is 0
+			int weightedCells = 0;
+
+			// connected regions of open cells, filled in by regions::build and kept up to date by regions::updateArea
+			int regionBlocksWide = 0;
+			std::vector<int> components; //per cell, the connected piece of its block it belongs to. -1 for obstacles
+			std::vector<int> componentRegions; //per component, the region it is part of
+
+			// per cell, the side of the largest open square with the cell as its top left corner, capped at MAX_AGENT_SIZE.
+			// an agent size cells wide can stand with its top left corner on any cell whose clearance is at least size
+			std::vector<uint8_t> clearance;
+			std::vector<std::shared_ptr<const Grid>> agentGrids; //[size - 2], only for sizes that were asked for
+
+			// per cell, bit i is set if a unit can step from it to its neighbour in neighborDirections[i]: the neighbour is
+			// on the level and not an obstacle, and for diagonals neither corner cell is either. the cell itself can be
+			// an obstacle, that only matters for stepping onto it
+			std::vector<uint8_t> neighborMasks;
+
+			// the last few updateArea calls, lets anything that keeps search state repair just the parts that changed
+			std::deque<ChangedArea> recentChanges;
+
+			int index(int col, int row) const {
+				return row * width + col;
+			}
+
+			int colOf(int cell) const {
+				return cell % width;
+			}
+
+			int rowOf(int cell) const {
+				return cell / width;
+			}
+
+			int cellCount() const {
+				return width * height;
+			}
+
+			bool withinBounds(int col, int row) const {
+				return col >= 0 && col < width && row >= 0 && row < height;
+			}
+
+			bool isObstacle(int cell) const {
+				return costs[cell] >= Config::OBSTACLE_COST;
+			}
+
+			bool canStep(int cell, int direction) const {
+				return (neighborMasks[cell] >> direction) & 1;
+			}
+
+			// how far apart in cell indices a cell and its neighbour in neighborDirections[direction] are
+			int stepOffset(int direction) const {
+				return neighborDirections[direction].second * width + neighborDirections[direction].first;
+			}
+
+			bool isUniformCost() const {
+				return weightedCells == 0;
+			}
+
+			// this grid as seen by agents size cells wide, where every cell they don't fit on is an obstacle. so searches
+			// for big agents are the same searches on a different grid. nullptr if it wasn't built (see agentGrid below)
+			const Grid* forAgentSize(int size) const;
+
+			// keeps the bitsets and counters in sync with the cost, always go through this to write a cost
+			void setCost(int cell, int cost);
+
+			// fills changes with everything changed after sinceVersion. returns false if that goes back further than
+			// recentChanges remembers (or past the last init), in which case the caller has to start over
+			bool changesSince(unsigned int sinceVersion, std::vector<ChangedArea>& changes) const;
+		};
+
+		/* calls visit(col, row) for every cell the straight line between the centres of two cells passes thru, in order and
+		leaving out the first one. where the line goes exactly thru a corner both cells beside it are visited before the
+		diagonal one. stops and returns false as soon as visit does*/
+		template<typename Visit>
+		bool forEachCellOnLine(int fromCol, int fromRow, int toCol, int toRow, Visit visit) {
+			int dCol = std::abs(toCol - fromCol), dRow = std::abs(toRow - fromRow);
+			int stepCol = toCol > fromCol ? 1 : -1, stepRow = toRow > fromRow ? 1 : -1;
+			int col = fromCol, row = fromRow;
+			for (int cols = 0, rows = 0; cols < dCol || rows < dRow;) {
+				//which cell border the line crosses next, in units of half a cell so it stays exact
+				int decision = (1 + 2 * cols) * dRow - (1 + 2 * rows) * dCol;
+				if (decision == 0) {
+					if (!visit(col + stepCol, row) || !visit(col, row + stepRow)) {
+						return false;
+					}
+					col += stepCol;
+					row += stepRow;
+					cols++;
+					rows++;
+				} else if (decision < 0) {
+					col += stepCol;
+					cols++;
+				} else {
+					row += stepRow;
+					rows++;
+				}
+				if (!visit(col, row)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		extern Grid grid;
+
+		// grid for agents of size cells wide, built the first time it's asked for and kept up to date by updateArea after that
+		const Grid& agentGrid(int size);
+
+		// builds target as the grid agents size cells wide see on level, level needs its clearance filled in
+		void buildAgentGrid(const Grid& level, int size, Grid& target);
+
+		// builds the grid (and everything the pathfinders derive from it) from the level cost map, call after the level is loaded
+		void init(const std::vector<std::vector<int>>& costMap);
+
+		// re-reads the costs inside the (inclusive) area from Global::levelTraversalCostMap
+		// call this after writing to the cost map, eg when a building is placed. derived data is only repaired around the area
+		void updateArea(int minCol, int minRow, int maxCol, int maxRow);
+	}
+}
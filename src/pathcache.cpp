@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include "pathcache.hpp"
+
+namespace AI {
+	namespace pathCache {
+		struct Key {
+			int startComponent;
+			int goalComponent;
+			int agentSize;
+
+			bool operator==(const Key& other) const {
+				return startComponent == other.startComponent && goalComponent == other.goalComponent &&
+					   agentSize == other.agentSize;
+			}
+		};
+
+		struct KeyHash {
+			size_t operator()(const Key& key) const {
+				return std::hash<int64_t>()((int64_t(key.startComponent) << 32) ^ key.goalComponent) ^ key.agentSize;
+			}
+		};
+
+		struct Entry {
+			Key key;
+			int width; //of the grid it was found on, a new level never reuses anything
+			unsigned int version; //grid version the corridor is known to be clear at
+			std::vector<int> cells;
+		};
+
+		//searches run on the path request workers too
+		std::mutex mutex;
+		std::list<Entry> entries; //most recently used first
+		std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+		int capacity = DEFAULT_CAPACITY;
+		Stats counters;
+
+		// the key for a path between the two cells, false if there's nothing worth caching
+		bool keyOf(const NavGrid::Grid& grid, int agentSize, int startCell, int goalCell, Key& key) {
+			if (grid.components.empty()) {
+				return false;
+			}
+			key = {grid.components[startCell], grid.components[goalCell], agentSize};
+			//obstacles aren't in any piece, and inside one piece the search is short anyway
+			return key.startComponent >= 0 && key.goalComponent >= 0 && key.startComponent != key.goalComponent;
+		}
+
+		// true if nothing changed on or right next to the corridor (diagonals can't cut corners) since it was stored
+		bool isStillClear(const NavGrid::Grid& grid, const Entry& entry) {
+			thread_local std::vector<NavGrid::ChangedArea> changes;
+			if (!grid.changesSince(entry.version, changes)) {
+				return false;
+			}
+			for (int cell : entry.cells) {
+				int col = grid.colOf(cell), row = grid.rowOf(cell);
+				for (const NavGrid::ChangedArea& area : changes) {
+					if (col >= area.minCol - 1 && col <= area.maxCol + 1 && row >= area.minRow - 1 && row <= area.maxRow + 1) {
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		// appends the cells of a short A* from one cell to another, leaving out the first one
+		bool appendSearch(const NavGrid::Grid& grid, int fromCell, int toCell, aStar::SearchWorkspace& workspace,
+						  std::vector<int>& cells) {
+			if (fromCell == toCell) {
+				return true;
+			}
+			if (!aStar::search(grid, fromCell, toCell, workspace)) {
+				return false;
+			}
+			size_t first = cells.size();
+			for (int cell = toCell; cell != fromCell; cell = workspace.parent(cell)) {
+				cells.push_back(cell);
+			}
+			std::reverse(cells.begin() + first, cells.end());
+			return true;
+		}
+
+		bool find(const NavGrid::Grid& grid, int agentSize, int startCell, int goalCell, aStar::SearchWorkspace& workspace,
+				  std::vector<int>& cells) {
+			Key key;
+			if (!keyOf(grid, agentSize, startCell, goalCell, key)) {
+				return false;
+			}
+
+			std::vector<int> corridor;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto it = index.find(key);
+				bool usable = it != index.end() && it->second->width == grid.width && it->second->version <= grid.version;
+				if (usable && it->second->version != grid.version) {
+					if (isStillClear(grid, *it->second)) {
+						it->second->version = grid.version;
+					} else {
+						counters.invalidated++;
+						entries.erase(it->second);
+						index.erase(it);
+						usable = false;
+					}
+				}
+				if (!usable) {
+					counters.misses++;
+					return false;
+				}
+				entries.splice(entries.begin(), entries, it->second);
+				corridor = it->second->cells;
+				counters.hits++;
+			}
+
+			//leave the corridor's start piece as late as possible and join its goal piece as early as possible,
+			//both pieces are connected so the searches onto and off the corridor stay inside them
+			int exit = -1, entry = -1;
+			for (int i = 0; i < (int) corridor.size(); i++) {
+				if (grid.components[corridor[i]] == key.startComponent) {
+					exit = i;
+				}
+			}
+			for (int i = std::max(exit, 0); i < (int) corridor.size() && entry < 0; i++) {
+				if (grid.components[corridor[i]] == key.goalComponent) {
+					entry = i;
+				}
+			}
+
+			cells.assign(1, startCell);
+			if (exit < 0 || entry < 0 || !appendSearch(grid, startCell, corridor[exit], workspace, cells)) {
+				return false;
+			}
+			cells.insert(cells.end(), corridor.begin() + exit + 1, corridor.begin() + entry + 1);
+			return appendSearch(grid, corridor[entry], goalCell, workspace, cells);
+		}
+
+		void store(const NavGrid::Grid& grid, int agentSize, const std::vector<int>& cells) {
+			Key key;
+			if (cells.size() < 2 || !keyOf(grid, agentSize, cells.front(), cells.back(), key)) {
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = index.find(key);
+			if (it != index.end()) {
+				entries.erase(it->second);
+				index.erase(it);
+			}
+			entries.push_front({key, grid.width, grid.version, cells});
+			index[key] = entries.begin();
+			while ((int) entries.size() > capacity) {
+				index.erase(entries.back().key);
+				entries.pop_back();
+				counters.evicted++;
+			}
+		}
+
+		Stats stats() {
+			std::lock_guard<std::mutex> lock(mutex);
+			return counters;
+		}
+
+		void setCapacity(int maxEntries) {
+			std::lock_guard<std::mutex> lock(mutex);
+			capacity = std::max(maxEntries, 1);
+		}
+
+		int size() {
+			std::lock_guard<std::mutex> lock(mutex);
+			return (int) entries.size();
+		}
+
+		void clear() {
+			std::lock_guard<std::mutex> lock(mutex);
+			entries.clear();
+			index.clear();
+			counters = Stats();
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include "navgrid.hpp"
+#include "pathfinder.hpp"
+
+/* paths found earlier, kept by the pieces of the region blocks (see NavGrid::Grid::components) their ends are in.
+units coming out of the same portal and heading for the same part of the base want nearly the same path, so a new
+request whose ends fall into the same two pieces reuses the old corridor and only searches the few cells from its own
+start onto it and from it to its own goal. entries are checked against the changes made to the grid since they were
+stored and only dropped if a change touched the corridor. cached paths can be a little longer than the best one*/
+namespace AI {
+	namespace pathCache {
+		const int DEFAULT_CAPACITY = 256;
+
+		struct Stats {
+			unsigned long long hits = 0;
+			unsigned long long misses = 0;
+			unsigned long long invalidated = 0; //entries dropped because something was built on their corridor
+			unsigned long long evicted = 0; //entries dropped to make room, least recently used first
+
+			double hitRate() const {
+				return hits + misses == 0 ? 0 : double(hits) / double(hits + misses);
+			}
+		};
+
+		/* fills cells with every cell from startCell to goalCell if a corridor between their pieces is cached, fixed up
+		at both ends with short searches on workspace. false on a miss*/
+		bool find(const NavGrid::Grid& grid, int agentSize, int startCell, int goalCell, aStar::SearchWorkspace& workspace,
+				  std::vector<int>& cells);
+
+		// keeps cells (every cell of a path, in order) for later requests between the same pieces
+		void store(const NavGrid::Grid& grid, int agentSize, const std::vector<int>& cells);
+
+		Stats stats();
+
+		void setCapacity(int maxEntries);
+
+		int size();
+
+		void clear();
+	}
+}
@@ -1,4 +1,10 @@
+#include <limits>
 #include "pathfinder.hpp"
+#include "hierarchicalpathfinder.hpp"
+#include "jumppointsearch.hpp"
+#include "landmarks.hpp"
+#include "pathcache.hpp"
+#include "regions.hpp"
 #include "global.hpp" //for ai cost map
 
 namespace AI {
@@ -9,16 +15,54 @@ namespace AI {
 			return Global::levelWithUnitsTraversalCostMap[z][x] < Config::OBSTACLE_COST;
 		}
 
-		std::vector<glm::vec3> reconstruct_path(const std::unordered_map<AStarNode, AStarNode, aStarHasher>& came_from,
-												const AStarNode& startNode, const AStarNode& goalNode,
+		void SearchWorkspace::beginSearch(int cellCount) {
+			frontier.clear();
+			if ((int) stamps.size() != cellCount) { //level changed size, start over
+				gScores.assign(cellCount, 0);
+				parents.assign(cellCount, -1);
+				stamps.assign(cellCount, 0);
+				generation = 0;
+				closedStamps.assign(cellCount, 0);
+				closedGeneration = 0;
+			}
+
+			generation++;
+			if (generation == 0) { //wrapped around, old stamps could now look current
+				std::fill(stamps.begin(), stamps.end(), 0);
+				generation = 1;
+			}
+			reopenAll();
+		}
+
+		void SearchWorkspace::reopenAll() {
+			closedGeneration++;
+			if (closedGeneration == 0) {
+				std::fill(closedStamps.begin(), closedStamps.end(), 0);
+				closedGeneration = 1;
+			}
+		}
+
+		SearchWorkspace& defaultWorkspace() {
+			thread_local SearchWorkspace workspace;
+			return workspace;
+		}
+
+		std::vector<glm::vec3> reconstruct_path(const NavGrid::Grid& grid, const SearchWorkspace& workspace,
+												int startCell, int goalCell,
 												const glm::vec3& startPos, const glm::vec3& goalPos) {
-			AStarNode current = goalNode;
 			std::vector<glm::vec3> path;
 			path.push_back(goalPos); //add the end as we need to interpolate from aStar int to last movement
 
-			while (current != startNode) {
-				path.emplace_back(current.colCoord, 0, current.rowCoord);
-				current = came_from.at(current); //use at() to satisfy const constraint
+			for (int current = goalCell; current != startCell; current = workspace.parent(current)) {
+				int col = grid.colOf(current), row = grid.rowOf(current);
+				int parent = workspace.parent(current);
+				int parentCol = grid.colOf(parent), parentRow = grid.rowOf(parent);
+				int dCol = (parentCol > col) - (parentCol < col);
+				int dRow = (parentRow > row) - (parentRow < row);
+				//units move one cell per waypoint so walk every cell back to the parent, not just the end points
+				for (; col != parentCol || row != parentRow; col += dCol, row += dRow) {
+					path.emplace_back(col, 0, row);
+				}
 			}
 			path.push_back(startPos); //add the start as we need to interpolate start to first movement
 
@@ -26,6 +70,57 @@ namespace AI {
 			return path;
 		}
 
+		std::vector<glm::vec3> cellsToPath(const NavGrid::Grid& grid, const std::vector<int>& cells,
+										   const glm::vec3& startPos, const glm::vec3& goalPos) {
+			std::vector<glm::vec3> path;
+			path.reserve(cells.size() + 1);
+			path.push_back(startPos);
+			for (size_t i = 1; i < cells.size(); i++) { //the start cell is covered by startPos
+				path.emplace_back(grid.colOf(cells[i]), 0, grid.rowOf(cells[i]));
+			}
+			path.push_back(goalPos);
+			return path;
+		}
+
+		bool lineOfSight(const NavGrid::Grid& grid, int fromCell, int toCell, int maxCost, int goalCell) {
+			return NavGrid::forEachCellOnLine(grid.colOf(fromCell), grid.rowOf(fromCell), grid.colOf(toCell), grid.rowOf(toCell),
+											  [&](int col, int row) {
+												  int cell = grid.index(col, row);
+												  return cell == goalCell || grid.costs[cell] <= maxCost;
+											  });
+		}
+
+		void smoothPath(const NavGrid::Grid& grid, std::vector<glm::vec3>& path, int goalCell) {
+			if (path.size() <= 3) {
+				return; //no corners to cut
+			}
+			//every waypoint but the exact goal position is on a cell, the start position is somewhere on the start cell
+			thread_local std::vector<int> cells;
+			cells.clear();
+			for (size_t i = 0; i + 1 < path.size(); i++) {
+				cells.push_back(grid.index(int(path[i].x + 0.5), int(path[i].z + 0.5)));
+			}
+			//paths can start or end on an obstacle, those costs don't say anything about the way in between
+			auto costOf = [&](int cell) {
+				return grid.isObstacle(cell) ? 0 : grid.costs[cell];
+			};
+
+			size_t kept = 1; //path[0], the start, always stays
+			int anchor = 0;
+			int maxCost = costOf(cells[0]);
+			for (int i = 1; i < (int) cells.size(); i++) {
+				maxCost = std::max(maxCost, costOf(cells[i]));
+				if (i - anchor > 1 && !lineOfSight(grid, cells[anchor], cells[i], maxCost, goalCell)) {
+					//the last one we could still see is a corner, start looking from there
+					anchor = i - 1;
+					path[kept++] = path[anchor];
+					maxCost = std::max(costOf(cells[anchor]), costOf(cells[i]));
+				}
+			}
+			path[kept++] = path.back(); //from the last corner straight to the goal position, which is on the last cell
+			path.resize(kept);
+		}
+
 		/* using L1 Norm (Manhattan norm) for stairstep like movement, for diagonal movement
 		we can consider either L-Infinity or L2 norm, leaving it for later*/
 		double l1_norm(const AStarNode& startNode, const AStarNode& goal) {
@@ -40,87 +135,198 @@ namespace AI {
 			return sqrt((rowDiff * rowDiff) + (colDiff * colDiff));
 		}
 
-		bool isGoalOrNotObstacle(int nextCol, int nextRow, int goalCol, int goalRow,
-								 const std::vector<std::vector<int>>& movementCostGraph) {
-			return (nextCol == goalCol && nextRow == goalRow) ||
-				   movementCostGraph[nextRow][nextCol] < Config::OBSTACLE_COST;
-		}
-
-		bool withinLevelBounds(int col, int row) {
-			return (col >= 0 && col < (int) Global::levelWidth) &&
-				   (row >= 0 && row < (int) Global::levelHeight);
+		int octileDistance(const NavGrid::Grid& grid, int cell, int goalCell) {
+			int rowDiff = std::abs(grid.rowOf(cell) - grid.rowOf(goalCell));
+			int colDiff = std::abs(grid.colOf(cell) - grid.colOf(goalCell));
+			return DIAGONAL_MOVEMENT_COST * std::min(rowDiff, colDiff) +
+				   STRAIGHT_MOVEMENT_COST * std::abs(rowDiff - colDiff);
 		}
 
-		std::vector<AStarNode>
-		getNeighbors(const std::vector<std::vector<int>>& movementCostGraph, const AStarNode& currentPos,
-					 const AStarNode& goal) {
-			int numOfRows = (int) movementCostGraph.size();
-			int numOfColumns = (int) movementCostGraph.front().size();
-			int row = currentPos.rowCoord;
-			int col = currentPos.colCoord;
-			int goalRow = goal.rowCoord;
-			int goalCol = goal.colCoord;
-			std::vector<AStarNode> neighbors;
-
-			/* costOfForwardMove = std::get<2>(graph[row][col + 1]);
-			a cost value of 1000 or larger is considered an obstacle
-			that the algorithm should avoid*/
-			if (col < 0 || col >= numOfColumns || row < 0 || col >= numOfRows) {
-				logger(LogLevel::ERR) << "ENTITY PATHING FROM OUT OF LEVEL \n";
-				throw "ENTITY PATHING FROM OUT OF LEVEL";
+		bool isGoalOrNotObstacle(const NavGrid::Grid& grid, int col, int row, int goalCell) {
+			if (!grid.withinBounds(col, row)) {
+				return false;
 			}
+			int cell = grid.index(col, row);
+			return cell == goalCell || !grid.isObstacle(cell);
+		}
 
-			//see https://stackoverflow.com/a/7627218
-			auto addNeighbours = [=, &neighbors](std::pair<int, int> dir, int movementCost) {
-				int nextCol = currentPos.colCoord + dir.first, nextRow = currentPos.rowCoord + dir.second;
-				if (withinLevelBounds(nextCol, nextRow) &&
-					isGoalOrNotObstacle(nextCol, nextRow, goalCol, goalRow, movementCostGraph)) {
+		void getNeighbors(const NavGrid::Grid& grid, int cell, int goalCell, NeighborBuffer& neighbors) {
+			int col = grid.colOf(cell);
+			int row = grid.rowOf(cell);
+			neighbors.clear();
 
-					neighbors.emplace_back(nextCol,
-										   nextRow,
-										   movementCostGraph[nextRow][nextCol] + movementCost,
-										   0 /*fscore gets set later*/,
-										   Global::levelArray[nextRow][nextCol]);
+			/* a cost value of 1000 or larger is considered an obstacle
+			that the algorithm should avoid. the masks already know which moves that leaves,
+			unless the goal is an obstacle right next to us: it counts as open, so check by hand*/
+			bool goalNextToUs = goalCell >= 0 && grid.isObstacle(goalCell) &&
+								std::abs(grid.colOf(goalCell) - col) <= 1 && std::abs(grid.rowOf(goalCell) - row) <= 1;
+			if (!goalNextToUs) {
+				uint8_t mask = grid.neighborMasks[cell];
+				for (int i = 0; i < (int) NavGrid::neighborDirections.size(); i++) {
+					if ((mask >> i) & 1) {
+						int next = cell + grid.stepOffset(i);
+						neighbors.add(next, grid.costs[next] + (i < 4 ? STRAIGHT_MOVEMENT_COST : DIAGONAL_MOVEMENT_COST));
+					}
 				}
-			};
+				return;
+			}
 
 			for (const auto& dir : straightDirections) {
-				addNeighbours(dir, STRAIGHT_MOVEMENT_COST);
+				int nextCol = col + dir.first, nextRow = row + dir.second;
+				if (isGoalOrNotObstacle(grid, nextCol, nextRow, goalCell)) {
+					int next = grid.index(nextCol, nextRow);
+					neighbors.add(next, grid.costs[next] + STRAIGHT_MOVEMENT_COST);
+				}
 			}
 
 			for (const auto& dir : diagonalDirections) {
+				int nextCol = col + dir.first, nextRow = row + dir.second;
 				//dont go thru diagonal corners
-				if (isGoalOrNotObstacle(currentPos.colCoord + dir.first, //check straight neighbours
-										currentPos.rowCoord,
-										goalCol, goalRow,
-										movementCostGraph) &&
-					isGoalOrNotObstacle(currentPos.colCoord,
-										currentPos.rowCoord + dir.second,
-										goalCol, goalRow,
-										movementCostGraph)) {
-					addNeighbours(dir, DIAGONAL_MOVEMENT_COST);
+				if (isGoalOrNotObstacle(grid, nextCol, nextRow, goalCell) &&
+					isGoalOrNotObstacle(grid, nextCol, row, goalCell) && //check straight neighbours
+					isGoalOrNotObstacle(grid, col, nextRow, goalCell)) {
+					int next = grid.index(nextCol, nextRow);
+					neighbors.add(next, grid.costs[next] + DIAGONAL_MOVEMENT_COST);
 				}
 			}
+		}
 
-			return neighbors;
+		bool search(const NavGrid::Grid& grid, int startCell, int goalCell, SearchWorkspace& workspace,
+					const landmarks::Landmarks* landmarks) {
+			ResumableSearch search(grid, startCell, goalCell, workspace, landmarks);
+			return search.step(std::numeric_limits<int>::max()) == ResumableSearch::Status::FOUND;
 		}
 
-		//returns a pair indicating whether the path was found, and the path itself
+		const landmarks::Landmarks& noLandmarks() {
+			static const landmarks::Landmarks none;
+			return none;
+		}
+
+		template <typename Frontier>
+		BasicResumableSearch<Frontier>::BasicResumableSearch(const NavGrid::Grid& grid, int startCell, int goalCell,
+															 SearchWorkspace& workspace,
+															 const landmarks::Landmarks* landmarks, float weight) :
+				grid(grid), goalCell(goalCell), workspace(workspace), frontier(workspace),
+				useLandmarks(landmarks && landmarks->landmarkCount() > 0),
+				estimate(grid, useLandmarks ? *landmarks : noLandmarks(), goalCell), heuristicWeight(std::max(weight, 1.0f)) {
+			/* the frontier stores the cells we have not explored yet in the level map
+			and hands out the one with the smallest f-score.
+			g-scores and the predecessor of each cell live in the workspace arrays*/
+			workspace.beginSearch(grid.cellCount());
+			workspace.visit(startCell, 0, startCell);
+			frontier.push(key(startCell), startCell);
+		}
+
+		template <typename Frontier>
+		int BasicResumableSearch<Frontier>::heuristic(int cell) const {
+			return useLandmarks ? estimate(cell) : octileDistance(grid, cell, goalCell);
+		}
+
+		template <typename Frontier>
+		typename BasicResumableSearch<Frontier>::Status BasicResumableSearch<Frontier>::step(int maxExpansions) {
+			NeighborBuffer neighbors;
+			for (int stepExpansions = 0; status == Status::RUNNING && stepExpansions < maxExpansions;) {
+				if (frontier.empty()) {
+					status = Status::NO_PATH;
+					break;
+				}
+				typename Frontier::Key currentKey;
+				int current = frontier.pop(currentKey);
+
+				if (current == goalCell) {
+					status = Status::FOUND;
+					break;
+				}
+
+				int currentGScore = workspace.gScore(current);
+				// a cheaper route to this cell was pushed after this entry, it has been expanded already
+				if (currentKey > key(current)) {
+					continue;
+				}
+				bool weighted = heuristicWeight > 1;
+				if (weighted) {
+					if (workspace.isClosed(current)) {
+						continue;
+					}
+					workspace.close(current);
+				}
+				stepExpansions++;
+				expanded++;
+
+				getNeighbors(grid, current, goalCell, neighbors);
+				for (const Neighbor& next : neighbors) {
+					// total movement cost to next node: path cost of current node + cost of taking
+					// a step from current to next node
+					int gScore = currentGScore + next.movementCost;
+					// if a neighbor node was not explored before, or we found a new path to it
+					// that has a lower cost
+					if (!workspace.isVisited(next.cell) || gScore < workspace.gScore(next.cell)) {
+						// record the cost and update predecessor of next node to our current node
+						workspace.visit(next.cell, gScore, current);
+						if (weighted && workspace.isClosed(next.cell)) {
+							inconsistent.push_back(next.cell); //left for the next improve
+							continue;
+						}
+						// add neighbor to open list of nodes to explore, f-score is g-score plus heuristic
+						frontier.push(key(next.cell), next.cell);
+					}
+				}
+			}
+			return status;
+		}
+
+		template <typename Frontier>
+		void BasicResumableSearch<Frontier>::improve(float newWeight) {
+			heuristicWeight = std::max(newWeight, 1.0f);
+			workspace.reopenAll();
+			//everything still open and everything that got cheaper after being expanded is open again, keyed by the new
+			//weight. the goal goes back in too, this search is done once nothing open could lead to a cheaper path to it
+			frontier.rekey([this](int cell) { return key(cell); });
+			for (int cell : inconsistent) {
+				frontier.push(key(cell), cell);
+			}
+			inconsistent.clear();
+			frontier.push(key(goalCell), goalCell);
+			status = Status::RUNNING;
+		}
+
+		template class BasicResumableSearch<HeapFrontier>;
+		template class BasicResumableSearch<BucketFrontier>;
+
 		std::pair<bool, std::vector<glm::vec3>>
 		findPath(const glm::vec3& start, const glm::vec3& goal, int tileSize) {
+			return findPath(start, goal, PathOptions(), tileSize);
+		}
 
-			/* a min heap that will store nodes we have not explored yet in the level map
-			will use it to fetch the tile node with the smallest f-score*/
-			std::priority_queue<AStarNode, std::vector<AStarNode>, aStarComparator> frontier;
+		std::pair<bool, std::vector<glm::vec3>>
+		findPath(const glm::vec3& start, const glm::vec3& goal, const PathOptions& options, int tileSize) {
+			return findPath(NavGrid::grid, hierarchical::graph, landmarks::landmarks, start, goal, options, defaultWorkspace(),
+							tileSize);
+		}
 
-			/* hash table that helps us keep track of how we reached a tile node
-			using a key of its predecessor node in the path*/
-			std::unordered_map<AStarNode, AStarNode, aStarHasher> came_from;
-			came_from.reserve(Global::levelWidth * Global::levelHeight);
+		//returns a pair indicating whether the path was found, and the path itself
+		std::pair<bool, std::vector<glm::vec3>>
+		findPath(const NavGrid::Grid& grid, const hierarchical::Graph& graph, const landmarks::Landmarks& landmarks,
+				 const glm::vec3& start, const glm::vec3& goal, const PathOptions& options, SearchWorkspace& workspace,
+				 int tileSize) {
+			PathSearch search(grid, graph, landmarks, start, goal, options, workspace, tileSize);
+			search.step(std::numeric_limits<int>::max());
+			return std::move(search.result());
+		}
 
-			// cost associated with a path up to a certain node
-			std::unordered_map<AStarNode, double, aStarHasher> cost_so_far;
-			cost_so_far.reserve(Global::levelWidth * Global::levelHeight);
+		PathSearch::PathSearch(const NavGrid::Grid& levelGrid, const hierarchical::Graph& graph,
+							   const landmarks::Landmarks& landmarks, const glm::vec3& start, const glm::vec3& goal,
+							   const PathOptions& options, SearchWorkspace& workspace, int tileSize) :
+				grid(&levelGrid), graph(graph), landmarks(landmarks), start(start), goal(goal), options(options),
+				workspace(workspace), mode(options.mode), found(false, std::vector<glm::vec3>()) {
+			//big agents search the grid where everything they don't fit on is blocked, so no search has to check footprints
+			agentSize = std::max(1, std::min(options.agentSize, NavGrid::MAX_AGENT_SIZE));
+			grid = levelGrid.forAgentSize(agentSize);
+			if (!grid) {
+				builtGrid = std::make_shared<NavGrid::Grid>();
+				NavGrid::buildAgentGrid(levelGrid, agentSize, *builtGrid);
+				grid = builtGrid.get();
+			}
 
 			// check which tiles the given positions lie in
 			// TODO: check coordinate signs ( -Z as opposed to +Z for tile positions)
@@ -129,50 +335,134 @@ namespace AI {
 			int goalRow = int((goal.z + 0.5) / tileSize);
 			int goalCol = int((goal.x + 0.5) / tileSize);
 
-			AStarNode startNode = AStarNode(startCol, startRow, Config::DEFAULT_TRAVERSABLE_COST,
-											0.0f, Model::MeshType::NONE);
-			AStarNode goalNode = AStarNode(goalCol, goalRow, Config::DEFAULT_TRAVERSABLE_COST,
-										   INF, Model::MeshType::NONE);
+			if (!grid->withinBounds(startCol, startRow)) {
+				logger(LogLevel::ERR) << "ENTITY PATHING FROM OUT OF LEVEL \n";
+				throw "ENTITY PATHING FROM OUT OF LEVEL";
+			}
+			if (!grid->withinBounds(goalCol, goalRow)) {
+				done = true; //nothing outside the level can be reached
+				return;
+			}
+
+			startCell = grid->index(startCol, startRow);
+			goalCell = grid->index(goalCol, goalRow);
+			if (!regions::canReach(*grid, startCell, goalCell)) {
+				done = true; //walled off, no need to search everything we can reach to find that out
+				return;
+			}
+
+			if (mode == SearchMode::INCREMENTAL || mode == SearchMode::COOPERATIVE) {
+				mode = SearchMode::JUMP_POINT; //no planner or reservations here, so it's as good as any other one off search
+			}
+			if (mode == SearchMode::HIERARCHICAL && (agentSize > 1 || graph.isLocal(*grid, startCell, goalCell))) {
+				mode = SearchMode::JUMP_POINT; //nothing to gain from the abstract graph, or it was built for single cells
+			}
+			if (mode == SearchMode::JUMP_POINT && !jumpPoint::canSearch(*grid)) {
+				mode = SearchMode::ASTAR;
+			}
+		}
 
-			//required to use this because of hashing being weird on floats
+		bool PathSearch::step(int maxExpansions) {
+			if (done) {
+				return true;
+			}
 
-			frontier.push(startNode);
-			came_from[startNode] = startNode;
-			cost_so_far[startNode] = 0.0;
+			if (options.cache && !checkedCache) {
+				checkedCache = true;
+				thread_local std::vector<int> cells;
+				if (pathCache::find(*grid, agentSize, startCell, goalCell, workspace, cells)) {
+					finish(cellsToPath(*grid, cells, start, goal), false);
+					return true;
+				}
+			}
 
-			while (!frontier.empty()) {
-				// top() does not remove the node, so call pop() after it
-				AStarNode current = frontier.top();
-				frontier.pop();
+			if (mode == SearchMode::HIERARCHICAL) {
+				thread_local std::vector<int> cells;
+				if (!graph.findPath(*grid, startCell, goalCell, workspace, cells)) {
+					done = true;
+					return true;
+				}
+				finish(cellsToPath(*grid, cells, start, goal), true);
+				return true;
+			}
 
-				if (current == goalNode) {
-					auto path = reconstruct_path(came_from, startNode, goalNode, start, goal);
-					// logger(LogLevel::INFO) << "Found path with length " << path.size() << " \n";
-					return {true, path}; //true for bool because we found a path
+			if (mode == SearchMode::JUMP_POINT) {
+				if (!jumpPoint::search(*grid, startCell, goalCell, workspace)) {
+					done = true;
+					return true;
+				}
+			} else {
+				if (!aStarSearch) {
+					float weight = mode == SearchMode::WEIGHTED ? options.weight : 1;
+					aStarSearch.reset(new ResumableSearch(*grid, startCell, goalCell, workspace, &landmarks, weight));
 				}
+				ResumableSearch::Status status = aStarSearch->step(maxExpansions);
+				if (status == ResumableSearch::Status::RUNNING) {
+					return false;
+				}
+				if (status == ResumableSearch::Status::NO_PATH || aStarSearch->weight() <= 1) {
+					aStarSearch.reset(); //nothing left to improve
+				}
+				if (status == ResumableSearch::Status::NO_PATH) {
+					done = true; //false for bool because we didn't find a path
+					return true;
+				}
+				pathCost = workspace.gScore(goalCell);
+			}
+			finish(reconstruct_path(*grid, workspace, startCell, goalCell, start, goal), true);
+			// logger(LogLevel::INFO) << "Found path with length " << path.size() << " \n";
+			return true;
+		}
 
-				std::vector<AStarNode> neighbors = getNeighbors(Global::levelTraversalCostMap, current, goalNode);
-				for (auto& next : neighbors) {
-					// total movement cost to next node: path cost of current node + cost of taking
-					// a step from current to next node
-					double gScore = cost_so_far[current] + next.movementCost;
-					// if a neighbor node was not explored before, or we found a new path to it
-					// that has a lower cost
-					if (cost_so_far.count(next) == 0 || gScore < cost_so_far[next]) {
-						// if neighbor node was found in the table update it
-						// if not, the [] operator will insert a new entry
-						cost_so_far[next] = gScore;
-						// calculate f-score based on g-score and heuristic
-						next.fScore = float(gScore + l2_norm(next, goalNode));
-						// add neighbor to open list of nodes to explore
-						frontier.push(next);
-						// update predecessor of next node to our current node
-						came_from[next] = current;
-					}
+		bool PathSearch::improve(int maxExpansions) {
+			if (!canImprove()) {
+				return false;
+			}
+			for (int stepExpansions = 0; stepExpansions < maxExpansions;) {
+				if (aStarSearch->state() == ResumableSearch::Status::FOUND) {
+					aStarSearch->improve(aStarSearch->weight() - WEIGHT_STEP);
+				}
+				int before = aStarSearch->expansions();
+				ResumableSearch::Status status = aStarSearch->step(maxExpansions - stepExpansions);
+				stepExpansions += aStarSearch->expansions() - before;
+				if (status == ResumableSearch::Status::RUNNING) {
+					return false;
+				}
+				bool best = status != ResumableSearch::Status::FOUND || aStarSearch->weight() <= 1;
+				int cost = workspace.gScore(goalCell);
+				if (best) {
+					aStarSearch.reset();
+				}
+				if (status == ResumableSearch::Status::FOUND && cost < pathCost) {
+					pathCost = cost;
+					finish(reconstruct_path(*grid, workspace, startCell, goalCell, start, goal), true);
+					return true;
+				}
+				if (best) {
+					return false;
 				}
 			}
+			return false;
+		}
 
-			return {false, {}}; //false for bool because we didn't find a path
+		void PathSearch::finish(std::vector<glm::vec3> path, bool remember) {
+			if (options.cache && remember) {
+				//every waypoint between the exact start and goal positions is a cell, none are skipped before smoothing
+				thread_local std::vector<int> cells;
+				cells.assign(1, startCell);
+				for (size_t i = 1; i + 1 < path.size(); i++) {
+					cells.push_back(grid->index(int(path[i].x), int(path[i].z)));
+				}
+				if (cells.back() != goalCell) {
+					cells.push_back(goalCell);
+				}
+				pathCache::store(*grid, agentSize, cells);
+			}
+			if (options.smooth) {
+				smoothPath(*grid, path, goalCell);
+			}
+			found = {true, std::move(path)}; //true for bool because we found a path
+			done = true;
 		}
 	}
 }
@@ -1,12 +1,20 @@
 #pragma once
 
 #include <algorithm>
-#include <queue>
-#include <unordered_map>
 #include <array>
-#include "level.hpp"
+#include <memory>
+#include <vector>
+#include "glm/glm.hpp"
+#include "astarnode.hpp"
+#include "bucketqueue.hpp"
+#include "landmarks.hpp"
+#include "navgrid.hpp"
 
 namespace AI {
+	namespace hierarchical {
+		class Graph;
+	}
+
 	namespace aStar {
 		//in delta x, delta z or (col,row) format
 		constexpr std::array<std::pair<int, int>, 4> straightDirections = {{
@@ -25,41 +33,349 @@ namespace AI {
 
 		const int STRAIGHT_MOVEMENT_COST = 10;
 		const int DIAGONAL_MOVEMENT_COST = 14;
+		const float WEIGHT_STEP = 0.5f; //how much closer to the best path every improvement of a WEIGHTED search gets
 
 		bool isTraversable(int x, int z);
 
-		// used to establish comparison between two tileNodes
+		enum class SearchMode {
+			ASTAR,
+			JUMP_POINT, //only used on uniform cost grids, falls back to ASTAR otherwise
+			HIERARCHICAL, //HPA*, close to optimal. short trips are searched with JUMP_POINT instead
+			INCREMENTAL, //D* Lite, the caller keeps a dStarLite::Planner to repair. one off searches use JUMP_POINT
+			COOPERATIVE, //WHCA*, planned a window at a time around other units' reservations. one off searches use JUMP_POINT
+			WEIGHTED, //ARA*, a path at most PathOptions::weight times as costly as the best one, found in far fewer expansions.
+			//PathSearch::improve keeps going towards the best path, reusing what was searched so far
+		};
+
+		// how a path should be searched for, picked per call
+		struct PathOptions {
+			SearchMode mode = SearchMode::ASTAR;
+			int agentSize = 1; //in cells, the path is for the top left cell of a square this wide. capped at MAX_AGENT_SIZE
+			bool smooth = false; //cut the path down to the corners it turns at, see smoothPath
+			bool cache = false; //reuse paths found earlier between the same parts of the level, see pathCache
+			float weight = 2.5f; //WEIGHTED only, how many times the best path's cost the first path may cost
+		};
+
+		// what sits in the open list: just the f-score and the cell index (row * width + col)
+		struct FrontierNode {
+			float fScore;
+			int cell;
+		};
+
+		// used to establish comparison between two frontier nodes
 		// based on f-score
 		struct aStarComparator {
-			// lambda expression
-			bool operator()(const AStarNode& a, const AStarNode& b) {
-				return a.fScore > b.fScore; //use > for min priority queue
+			bool operator()(const FrontierNode& a, const FrontierNode& b) const {
+				return a.fScore > b.fScore; //use > for min heap
 			}
 		};
 
-		/* generate hash key which is fairly unique for each tile*/
-		struct aStarHasher {
-			std::size_t operator()(const AStarNode& in) const noexcept {
-				size_t result = std::hash<int>{}(in.rowCoord);
-				hash_combine(result, std::hash<int>{}(in.colCoord));
-				return result;
+		struct Neighbor {
+			int cell;
+			int movementCost; //cost of stepping from the expanded cell onto this one
+		};
+
+		// a cell has at most 8 neighbours, so expanding a node never has to allocate
+		struct NeighborBuffer {
+			std::array<Neighbor, 8> items;
+			int count = 0;
+
+			void clear() {
+				count = 0;
+			}
+
+			void add(int cell, int movementCost) {
+				items[count++] = {cell, movementCost};
+			}
+
+			const Neighbor* begin() const {
+				return items.data();
+			}
+
+			const Neighbor* end() const {
+				return items.data() + count;
 			}
 		};
 
+		/* per cell g-scores and parents that get reused between searches instead of being rebuilt every call.
+		each cell is stamped with the generation of the search that last touched it, anything with an old
+		stamp counts as unvisited so starting a new search doesn't need to clear anything*/
+		class SearchWorkspace {
+		public:
+			std::vector<FrontierNode> frontier; //storage for the binary heap, keeps its capacity between searches
+			BucketQueue buckets; //storage for BucketFrontier
+
+			// starts a new search over a grid with cellCount cells
+			void beginSearch(int cellCount);
+
+			bool isVisited(int cell) const {
+				return stamps[cell] == generation;
+			}
+
+			// closed cells are only tracked by searches that must not expand a cell twice, see ResumableSearch
+			bool isClosed(int cell) const {
+				return closedStamps[cell] == closedGeneration;
+			}
+
+			void close(int cell) {
+				closedStamps[cell] = closedGeneration;
+			}
+
+			// opens every cell again without touching the g-scores and parents
+			void reopenAll();
+
+			int gScore(int cell) const {
+				return gScores[cell];
+			}
+
+			int parent(int cell) const {
+				return parents[cell];
+			}
+
+			void visit(int cell, int gScore, int parent) {
+				stamps[cell] = generation;
+				gScores[cell] = gScore;
+				parents[cell] = parent;
+			}
+
+		private:
+			std::vector<int> gScores;
+			std::vector<int> parents;
+			std::vector<unsigned int> stamps;
+			unsigned int generation = 0;
+			std::vector<unsigned int> closedStamps;
+			unsigned int closedGeneration = 0;
+		};
+
+		// workspace used by findPath when the caller doesn't bring their own, one per thread
+		SearchWorkspace& defaultWorkspace();
+
 		// L1 norm (manhattan distance), will be used as a heuristic for A*
 		double l1_norm(const AStarNode& a, const AStarNode& b);
 
 		double l2_norm(const AStarNode& startNode, const AStarNode& goal);
 
-		// find list of adjacent tile nodes which constitute possible moves from the position we're currently at
-		std::vector<AStarNode> getNeighbors(const std::vector<std::vector<AStarNode>>& graph,
-											const AStarNode& currentPos, const AStarNode& goal);
+		// exact cost of walking between two cells on an open grid, using the straight and diagonal movement costs
+		int octileDistance(const NavGrid::Grid& grid, int cell, int goalCell);
+
+		// find list of adjacent cells which constitute possible moves from the cell we're currently at
+		void getNeighbors(const NavGrid::Grid& grid, int cell, int goalCell, NeighborBuffer& neighbors);
+
+		/* plain A* from startCell to goalCell, leaves the parents in the workspace. returns false if there is no path.
+		with landmarks the ALT estimate is used as the heuristic, otherwise straight line distance*/
+		bool search(const NavGrid::Grid& grid, int startCell, int goalCell, SearchWorkspace& workspace,
+					const landmarks::Landmarks* landmarks = nullptr);
+
+		/* where ResumableSearch keeps the cells it has yet to expand, picked at compile time so they can be compared on the
+		same searches. HeapFrontier is a binary heap on float keys in SearchWorkspace::frontier. BucketFrontier uses the
+		integer keys all our costs and heuristics give, pushing and popping are then constant time (see BucketQueue)*/
+		class HeapFrontier {
+		public:
+			typedef float Key;
+
+			explicit HeapFrontier(SearchWorkspace& workspace) : nodes(workspace.frontier) {
+				nodes.clear();
+			}
+
+			bool empty() const {
+				return nodes.empty();
+			}
+
+			void push(Key key, int cell) {
+				nodes.push_back({key, cell});
+				std::push_heap(nodes.begin(), nodes.end(), aStarComparator());
+			}
+
+			int pop(Key& key) {
+				std::pop_heap(nodes.begin(), nodes.end(), aStarComparator());
+				FrontierNode node = nodes.back();
+				nodes.pop_back();
+				key = node.fScore;
+				return node.cell;
+			}
+
+			template <typename KeyOf>
+			void rekey(KeyOf keyOf) {
+				for (FrontierNode& node : nodes) {
+					node.fScore = keyOf(node.cell);
+				}
+				std::make_heap(nodes.begin(), nodes.end(), aStarComparator());
+			}
+
+		private:
+			std::vector<FrontierNode>& nodes;
+		};
+
+		class BucketFrontier {
+		public:
+			typedef int Key;
+
+			explicit BucketFrontier(SearchWorkspace& workspace) : queue(workspace.buckets) {
+				queue.clear();
+			}
+
+			bool empty() const {
+				return queue.empty();
+			}
+
+			void push(Key key, int cell) {
+				queue.push(key, cell);
+			}
+
+			int pop(Key& key) {
+				return queue.pop(key);
+			}
+
+			template <typename KeyOf>
+			void rekey(KeyOf keyOf) {
+				queue.rekey(keyOf);
+			}
+
+		private:
+			BucketQueue& queue;
+		};
+
+		/* the same A* as search, but it can stop after any number of expansions and carry on from there later.
+		the grid, landmarks and workspace have to be left alone until it's done.
+		with a weight over 1 the heuristic is inflated by it, so paths cost at most weight times the best one (weighted A*).
+		every cell is then expanded at most once, cells that get cheaper after that are kept aside so improve can lower the
+		weight and carry on from where the last search stopped instead of starting over (ARA*, Likhachev 2003)*/
+		template <typename Frontier>
+		class BasicResumableSearch {
+		public:
+			enum class Status {
+				RUNNING,
+				FOUND,
+				NO_PATH,
+			};
+
+			BasicResumableSearch(const NavGrid::Grid& grid, int startCell, int goalCell, SearchWorkspace& workspace,
+								 const landmarks::Landmarks* landmarks = nullptr, float weight = 1);
+
+			// expands up to maxExpansions more cells
+			Status step(int maxExpansions);
+
+			/* once a path was FOUND, looks for a better one with the lower weight. step it again until it's FOUND,
+			the path it finds is never worse than the last one*/
+			void improve(float newWeight);
+
+			Status state() const {
+				return status;
+			}
+
+			float weight() const {
+				return heuristicWeight;
+			}
+
+			int expansions() const {
+				return expanded;
+			}
+
+		private:
+			// the ALT estimate with landmarks, the octile distance without
+			int heuristic(int cell) const;
+
+			typename Frontier::Key key(int cell) const {
+				return typename Frontier::Key(workspace.gScore(cell) + heuristicWeight * heuristic(cell));
+			}
+
+			const NavGrid::Grid& grid;
+			int goalCell;
+			SearchWorkspace& workspace;
+			Frontier frontier;
+			bool useLandmarks;
+			landmarks::Estimate estimate;
+			float heuristicWeight;
+			std::vector<int> inconsistent; //expanded cells that got cheaper afterwards, only kept with a weight over 1
+			Status status = Status::RUNNING;
+			int expanded = 0;
+		};
+
+		/* the frontier every search uses. on open levels like 200sands BucketFrontier expands a tenth of the cells, as it
+		breaks ties between equal f-scores newest first, and each expansion is cheaper too*/
+		typedef BasicResumableSearch<BucketFrontier> ResumableSearch;
 
 		//main pathfinding algorithm
 		std::pair<bool, std::vector<glm::vec3>>
 		findPath(const glm::vec3& start, const glm::vec3& goal, int tileSize = 1);
 
-		std::vector<glm::vec3> reconstruct_path(const std::unordered_map<AStarNode, AStarNode, aStarHasher>& came_from,
-												const AStarNode& start, const AStarNode& goal);
+		std::pair<bool, std::vector<glm::vec3>>
+		findPath(const glm::vec3& start, const glm::vec3& goal, const PathOptions& options, int tileSize = 1);
+
+		// same as above but against the given grid, graph and landmarks instead of the live ones, so copies of the level can be
+		// searched off the main thread
+		std::pair<bool, std::vector<glm::vec3>>
+		findPath(const NavGrid::Grid& grid, const hierarchical::Graph& graph, const landmarks::Landmarks& landmarks,
+				 const glm::vec3& start, const glm::vec3& goal, const PathOptions& options, SearchWorkspace& workspace,
+				 int tileSize = 1);
+
+		/* findPath split up so it can be spread over several ticks, findPath is this stepped until it's done.
+		ASTAR and WEIGHTED searches stop wherever step runs out of expansions, the other modes expand a lot fewer cells and finish
+		in the step that starts them. everything passed in has to outlive it, the same as for ResumableSearch*/
+		class PathSearch {
+		public:
+			// throws like findPath if start is outside the level
+			PathSearch(const NavGrid::Grid& levelGrid, const hierarchical::Graph& graph, const landmarks::Landmarks& landmarks,
+					   const glm::vec3& start, const glm::vec3& goal, const PathOptions& options, SearchWorkspace& workspace,
+					   int tileSize = 1);
+
+			// searches on for up to maxExpansions cells, returns true once it's done
+			bool step(int maxExpansions);
+
+			bool isDone() const {
+				return done;
+			}
+
+			// whether a path was found and the path, only valid once done
+			std::pair<bool, std::vector<glm::vec3>>& result() {
+				return found;
+			}
+
+			// WEIGHTED searches only, true while the path found could still be made better
+			bool canImprove() const {
+				return done && aStarSearch != nullptr;
+			}
+
+			// looks for a better path for up to maxExpansions cells, returns true if result has a cheaper one now
+			bool improve(int maxExpansions);
+
+		private:
+			// remember says whether the path came from a search and should go into the cache
+			void finish(std::vector<glm::vec3> path, bool remember);
+
+			const NavGrid::Grid* grid;
+			std::shared_ptr<NavGrid::Grid> builtGrid; //agent grid the level didn't have, see NavGrid::agentGrid
+			const hierarchical::Graph& graph;
+			const landmarks::Landmarks& landmarks;
+			glm::vec3 start, goal;
+			PathOptions options;
+			SearchWorkspace& workspace;
+			SearchMode mode;
+			int agentSize;
+			int startCell = -1, goalCell = -1;
+			bool checkedCache = false;
+			std::unique_ptr<ResumableSearch> aStarSearch; //ASTAR and WEIGHTED, kept after it's done while it can be improved
+			int pathCost = 0; //of the last path found by aStarSearch
+			bool done = false;
+			std::pair<bool, std::vector<glm::vec3>> found;
+		};
+
+		// turns a list of adjacent cells into waypoints, framed by the exact start and goal positions
+		std::vector<glm::vec3> cellsToPath(const NavGrid::Grid& grid, const std::vector<int>& cells,
+										   const glm::vec3& startPos, const glm::vec3& goalPos);
+
+		/* true if a unit can walk in a straight line from the centre of one cell to the centre of the other. every cell on the
+		way has to be open and cost no more than maxCost, goalCell counts as open like it does for the searches*/
+		bool lineOfSight(const NavGrid::Grid& grid, int fromCell, int toCell, int maxCost, int goalCell);
+
+		/* string pulling: drops every waypoint the unit can walk past in a straight line, so only the corners are left.
+		a shortcut never goes thru cells more expensive than the ones on the stretch of path it replaces.
+		path is in the findPath format, goalCell is where it ends*/
+		void smoothPath(const NavGrid::Grid& grid, std::vector<glm::vec3>& path, int goalCell);
+
+		// parents don't have to be adjacent, as long as they are on a straight or diagonal line the cells in between get filled in
+		std::vector<glm::vec3> reconstruct_path(const NavGrid::Grid& grid, const SearchWorkspace& workspace,
+												int startCell, int goalCell,
+												const glm::vec3& startPos, const glm::vec3& goalPos);
 	}
 }
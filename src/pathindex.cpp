@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <unordered_map>
+#include "pathindex.hpp"
+
+namespace AI {
+	namespace pathIndex {
+		struct IndexedPath {
+			Entity* entity;
+			std::vector<int> cells; //every cell the path goes thru
+			std::vector<int> blocks; //the blocks those cells are in, each once
+		};
+
+		std::unordered_map<const Entity*, IndexedPath> paths;
+		std::vector<std::vector<Entity*>> blocks; //entities with a path thru each block
+		int width = 0;
+		int height = 0;
+		int blocksWide = 0;
+		unsigned int seenVersion = 0; //grid version takeAffected last caught up to
+		std::vector<NavGrid::ChangedArea> changes;
+
+		void clear() {
+			paths.clear();
+			blocks.clear();
+			width = height = blocksWide = 0;
+		}
+
+		void remove(const Entity* entity) {
+			auto it = paths.find(entity);
+			if (it == paths.end()) {
+				return;
+			}
+			for (int block : it->second.blocks) {
+				std::vector<Entity*>& entities = blocks[block];
+				auto found = std::find(entities.begin(), entities.end(), entity);
+				*found = entities.back();
+				entities.pop_back();
+			}
+			paths.erase(it);
+		}
+
+		void add(Entity* entity, const std::vector<glm::vec3>& path, int agentSize) {
+			remove(entity);
+			const NavGrid::Grid& grid = NavGrid::grid;
+			if (path.empty()) {
+				return;
+			}
+			if (grid.width != width || grid.height != height) { //new level, nothing indexed still applies
+				clear();
+				width = grid.width;
+				height = grid.height;
+				blocksWide = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+				blocks.resize(blocksWide * ((height + BLOCK_SIZE - 1) / BLOCK_SIZE));
+				seenVersion = grid.version;
+			}
+
+			IndexedPath& indexed = paths[entity];
+			indexed.entity = entity;
+			auto addCell = [&](int minCol, int minRow) {
+				//every cell under the agent, not just the one it paths for
+				for (int row = minRow; row < minRow + agentSize; row++) {
+					for (int col = minCol; col < minCol + agentSize; col++) {
+						if (!grid.withinBounds(col, row)) {
+							continue;
+						}
+						indexed.cells.push_back(grid.index(col, row));
+						int block = (row / BLOCK_SIZE) * blocksWide + col / BLOCK_SIZE;
+						//paths walk from block to block, so a block that was seen before is almost always the last one
+						if (std::find(indexed.blocks.begin(), indexed.blocks.end(), block) == indexed.blocks.end()) {
+							indexed.blocks.push_back(block);
+							blocks[block].push_back(entity);
+						}
+					}
+				}
+				return true;
+			};
+			//smoothed paths only keep their corners, the cells in between are the ones on the straight lines
+			addCell(int(path.front().x + 0.5), int(path.front().z + 0.5));
+			for (size_t i = 1; i < path.size(); i++) {
+				NavGrid::forEachCellOnLine(int(path[i - 1].x + 0.5), int(path[i - 1].z + 0.5),
+										   int(path[i].x + 0.5), int(path[i].z + 0.5), addCell);
+			}
+		}
+
+		// true if the path goes thru or right next to the area, diagonal steps can't cut corners so a building on the corner
+		// of one blocks it without being on the path
+		bool crosses(const NavGrid::Grid& grid, const IndexedPath& path, const NavGrid::ChangedArea& area) {
+			for (int cell : path.cells) {
+				int col = grid.colOf(cell), row = grid.rowOf(cell);
+				if (col >= area.minCol - 1 && col <= area.maxCol + 1 && row >= area.minRow - 1 && row <= area.maxRow + 1) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void takeAffected(const NavGrid::Grid& grid, std::vector<Entity*>& affected) {
+			affected.clear();
+			if (seenVersion == grid.version) {
+				return;
+			}
+			bool complete = grid.changesSince(seenVersion, changes);
+			seenVersion = grid.version;
+			if (!complete || grid.width != width || grid.height != height) {
+				//lost track of what changed, everyone searches again
+				for (auto& path : paths) {
+					affected.push_back(path.second.entity);
+				}
+				return;
+			}
+
+			int blocksHigh = (int) blocks.size() / blocksWide;
+			for (const NavGrid::ChangedArea& change : changes) {
+				//the paths next to the area count too, and they can be in the blocks around it
+				int firstRow = std::max(change.minRow - 1, 0) / BLOCK_SIZE;
+				int lastRow = std::min((change.maxRow + 1) / BLOCK_SIZE, blocksHigh - 1);
+				int firstCol = std::max(change.minCol - 1, 0) / BLOCK_SIZE;
+				int lastCol = std::min((change.maxCol + 1) / BLOCK_SIZE, blocksWide - 1);
+				for (int blockRow = firstRow; blockRow <= lastRow; blockRow++) {
+					for (int blockCol = firstCol; blockCol <= lastCol; blockCol++) {
+						for (Entity* entity : blocks[blockRow * blocksWide + blockCol]) {
+							if (std::find(affected.begin(), affected.end(), entity) == affected.end() &&
+								crosses(grid, paths[entity], change)) {
+								affected.push_back(entity);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		int indexedCount() {
+			return (int) paths.size();
+		}
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "navgrid.hpp"
+
+class Entity;
+
+/* which entities are walking a path through which part of the level. the level is cut into blocks and every block lists the
+entities with a path crossing it, so when costs change only the entities listed in the changed blocks have to be checked
+and only the ones whose path really crosses or touches a changed cell have to search again*/
+namespace AI {
+	namespace pathIndex {
+		const int BLOCK_SIZE = 8;
+
+		// indexes the cells of path for entity, replacing whatever was indexed for it before. an empty path removes it.
+		// agents wider than a cell cover agentSize cells to the right of and below each waypoint
+		void add(Entity* entity, const std::vector<glm::vec3>& path, int agentSize = 1);
+
+		void remove(const Entity* entity);
+
+		// fills affected with the entities whose indexed path crosses or passes right next to a cell that changed in grid
+		// since the last call
+		void takeAffected(const NavGrid::Grid& grid, std::vector<Entity*>& affected);
+
+		int indexedCount();
+
+		void clear();
+	}
+}
@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include "pathrequests.hpp"
+#include "hierarchicalpathfinder.hpp"
+#include "landmarks.hpp"
+#include "common.hpp" //for logger
+
+namespace AI {
+	namespace pathRequests {
+		typedef std::pair<bool, std::vector<glm::vec3>> Result;
+
+		// what the workers search, copied from the live level so it can keep changing on the main thread
+		struct Snapshot {
+			NavGrid::Grid grid;
+			hierarchical::Graph graph;
+			landmarks::Landmarks landmarks; //shares the tables with the live level, they are never changed once built
+		};
+
+		struct Request {
+			RequestId id;
+			glm::vec3 start, goal;
+			aStar::PathOptions options;
+			Priority priority;
+			std::shared_ptr<const Snapshot> snapshot;
+		};
+
+		// the search update is working thru when there are no workers, kept between ticks until it's done
+		struct ActiveSearch {
+			Request request;
+			std::unique_ptr<aStar::PathSearch> search;
+			bool improving = false; //the first path was delivered, looking for better ones
+		};
+
+		const int EXPANSIONS_PER_CLOCK_CHECK = 256;
+
+		std::mutex mutex; //guards everything shared with the workers: queue, inProgress, improving, cancelled, solved and stopping
+		std::condition_variable wakeWorkers;
+		std::vector<std::thread> workers;
+		bool stopping = false;
+
+		std::deque<Request> queue; //sorted by priority
+		std::unordered_set<RequestId> inProgress; //taken off the queue by a worker
+		std::unordered_set<RequestId> improving; //delivered, the worker is looking for better paths while it's idle
+		std::unordered_set<RequestId> cancelled; //cancelled while a worker had it, dropped when it's done
+		std::unordered_map<RequestId, Result> solved; //done since the last update
+
+		//main thread only
+		std::unordered_map<RequestId, Result> delivered;
+		std::shared_ptr<const Snapshot> snapshot;
+		RequestId nextId = NO_REQUEST + 1;
+		std::unique_ptr<ActiveSearch> active;
+		aStar::SearchWorkspace activeWorkspace; //not the default one, other searches on the main thread would clobber it
+		int budgetMicroseconds = DEFAULT_BUDGET_MICROSECONDS;
+		BudgetStats stats;
+
+		// nullptr if the start is outside the level, findPath already logged it
+		std::unique_ptr<aStar::PathSearch> startSearch(const Request& request, aStar::SearchWorkspace& workspace) {
+			try {
+				return std::unique_ptr<aStar::PathSearch>(
+						new aStar::PathSearch(request.snapshot->grid, request.snapshot->graph, request.snapshot->landmarks,
+											  request.start, request.goal, request.options, workspace));
+			} catch (const char*) {
+				return nullptr;
+			}
+		}
+
+		Result solve(std::unique_ptr<aStar::PathSearch>& search) {
+			if (!search) {
+				return {false, {}};
+			}
+			search->step(std::numeric_limits<int>::max());
+			return search->result();
+		}
+
+		// with the mutex held. better paths are only worth looking for while nobody is waiting on a first one
+		bool keepImproving(const aStar::PathSearch& search, RequestId id) {
+			return search.canImprove() && !stopping && queue.empty() && cancelled.count(id) == 0;
+		}
+
+		void workerLoop() {
+			std::unique_lock<std::mutex> lock(mutex);
+			while (true) {
+				wakeWorkers.wait(lock, [] { return stopping || !queue.empty(); });
+				if (stopping) {
+					return;
+				}
+
+				Request request = std::move(queue.front());
+				queue.pop_front();
+				inProgress.insert(request.id);
+
+				lock.unlock();
+				std::unique_ptr<aStar::PathSearch> search = startSearch(request, aStar::defaultWorkspace());
+				Result result = solve(search);
+				lock.lock();
+
+				inProgress.erase(request.id);
+				if (cancelled.count(request.id) == 0) {
+					solved[request.id] = std::move(result);
+				}
+				if (search && keepImproving(*search, request.id)) {
+					improving.insert(request.id);
+					while (keepImproving(*search, request.id)) {
+						lock.unlock();
+						bool improved = search->improve(EXPANSIONS_PER_CLOCK_CHECK);
+						lock.lock();
+						if (improved && cancelled.count(request.id) == 0) {
+							solved[request.id] = search->result();
+						}
+					}
+					improving.erase(request.id);
+				}
+				cancelled.erase(request.id);
+				search.reset();
+				request.snapshot.reset(); //let go of old copies of the level as soon as possible
+			}
+		}
+
+		const std::shared_ptr<const Snapshot>& currentSnapshot(int agentSize) {
+			if (!snapshot || snapshot->grid.version != NavGrid::grid.version || !snapshot->grid.forAgentSize(agentSize)) {
+				snapshot = std::make_shared<const Snapshot>(Snapshot{NavGrid::grid, hierarchical::graph, landmarks::landmarks});
+			}
+			return snapshot;
+		}
+
+		void init(unsigned int workerCount) {
+			shutdown();
+			if (workerCount == 0) {
+				unsigned int cores = std::thread::hardware_concurrency();
+				workerCount = cores > 1 ? cores - 1 : 0; //leave the main thread a core
+			}
+
+			stopping = false;
+			for (unsigned int i = 0; i < workerCount; i++) {
+				workers.emplace_back(workerLoop);
+			}
+			logger(LogLevel::INFO) << "Started " << workerCount << " path request workers\n";
+		}
+
+		void shutdown() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+				queue.clear();
+			}
+			wakeWorkers.notify_all();
+			for (std::thread& worker : workers) {
+				worker.join();
+			}
+			workers.clear();
+
+			inProgress.clear();
+			improving.clear();
+			cancelled.clear();
+			solved.clear();
+			delivered.clear();
+			snapshot.reset();
+			active.reset();
+		}
+
+		RequestId request(const glm::vec3& start, const glm::vec3& goal, const aStar::PathOptions& options,
+						  Priority priority) {
+			RequestId id = nextId++;
+			if (nextId == NO_REQUEST) {
+				nextId++;
+			}
+			NavGrid::agentGrid(options.agentSize); //built on the live level so the snapshot and later ones share it
+			Request request{id, start, goal, options, priority, currentSnapshot(options.agentSize)};
+
+			// pathing from outside the level logs an error, and the logger isn't safe to use from the workers
+			bool startInLevel = NavGrid::grid.withinBounds(int(start.x + 0.5), int(start.z + 0.5));
+			if (!startInLevel) {
+				std::unique_ptr<aStar::PathSearch> search = startSearch(request, aStar::defaultWorkspace());
+				Result result = solve(search);
+				std::lock_guard<std::mutex> lock(mutex);
+				solved[id] = std::move(result);
+				return id;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto after = std::find_if(queue.begin(), queue.end(), [&](const Request& queued) {
+					return queued.priority > priority;
+				});
+				queue.insert(after, std::move(request));
+			}
+			wakeWorkers.notify_one();
+			return id;
+		}
+
+		void cancel(RequestId id) {
+			if (id == NO_REQUEST) {
+				return;
+			}
+			delivered.erase(id);
+			if (active && active->request.id == id) {
+				active.reset();
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (solved.erase(id) > 0) {
+				return;
+			}
+			if (inProgress.count(id) > 0 || improving.count(id) > 0) {
+				cancelled.insert(id);
+				return;
+			}
+			for (auto it = queue.begin(); it != queue.end(); ++it) {
+				if (it->id == id) {
+					queue.erase(it);
+					return;
+				}
+			}
+		}
+
+		// runs the queue on the main thread until the budget is used up, at least one step every tick so it always gets thru
+		void searchWithinBudget() {
+			typedef std::chrono::steady_clock Clock;
+			Clock::time_point begin = Clock::now();
+			Clock::time_point deadline = begin + std::chrono::microseconds(budgetMicroseconds);
+			bool searched = false;
+			do {
+				if (!active || active->improving) {
+					std::lock_guard<std::mutex> lock(mutex);
+					if (!queue.empty()) {
+						//a better path for a unit that's already walking can wait, the workspace is needed now
+						active.reset(new ActiveSearch{std::move(queue.front()), nullptr});
+						queue.pop_front();
+					} else if (!active) {
+						break;
+					}
+				}
+				searched = true;
+
+				const Request& request = active->request;
+				if (active->improving) {
+					if (active->search->improve(EXPANSIONS_PER_CLOCK_CHECK)) {
+						std::lock_guard<std::mutex> lock(mutex);
+						solved[request.id] = active->search->result();
+					}
+					if (!active->search->canImprove()) {
+						active.reset();
+					}
+					continue;
+				}
+				if (!active->search) {
+					active->search.reset(new aStar::PathSearch(request.snapshot->grid, request.snapshot->graph,
+															   request.snapshot->landmarks, request.start, request.goal,
+															   request.options, activeWorkspace));
+				}
+				if (active->search->step(EXPANSIONS_PER_CLOCK_CHECK)) {
+					std::lock_guard<std::mutex> lock(mutex);
+					solved[request.id] = active->search->result();
+					active->improving = active->search->canImprove();
+					if (!active->improving) {
+						active.reset();
+					}
+				}
+			} while (Clock::now() < deadline);
+
+			if (!searched) {
+				return;
+			}
+			long long spent = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - begin).count();
+			stats.ticks++;
+			stats.lastTickMicroseconds = spent;
+			if (spent > budgetMicroseconds) {
+				stats.overruns++;
+				stats.worstOverrunMicroseconds = std::max(stats.worstOverrunMicroseconds, spent - budgetMicroseconds);
+			}
+			if (active && !active->improving) {
+				stats.suspended++;
+			}
+		}
+
+		void update() {
+			delivered.clear();
+			if (workers.empty()) {
+				searchWithinBudget();
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			delivered.swap(solved);
+		}
+
+		bool takeResult(RequestId id, std::pair<bool, std::vector<glm::vec3>>& result) {
+			auto it = delivered.find(id);
+			if (it == delivered.end()) {
+				return false;
+			}
+			result = std::move(it->second);
+			delivered.erase(it);
+			return true;
+		}
+
+		int pendingCount() {
+			std::lock_guard<std::mutex> lock(mutex);
+			int searching = active && !active->improving ? 1 : 0;
+			for (RequestId id : inProgress) {
+				searching += cancelled.count(id) == 0 ? 1 : 0;
+			}
+			return int(queue.size() + solved.size() + delivered.size()) + searching;
+		}
+
+		void setBudget(int microseconds) {
+			budgetMicroseconds = microseconds;
+		}
+
+		const BudgetStats& budgetStats() {
+			return stats;
+		}
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include "glm/glm.hpp"
+#include "pathfinder.hpp"
+
+/* path requests that get solved on worker threads so a burst of orders doesn't stall the frame.
+requests are searched against a read only copy of the level taken when they are made (a new copy is only taken
+after the level changes), and results only show up after the next call to update so entities always get
+them on a later tick. without workers update searches on the main thread, but only for as long as the budget allows.
+a search that runs out of time stops where it is and carries on the next tick. either way requests are taken in
+priority order. WEIGHTED searches keep getting better while nothing else is waiting, see takeResult*/
+namespace AI {
+	namespace pathRequests {
+		typedef unsigned int RequestId;
+		const RequestId NO_REQUEST = 0;
+		const int DEFAULT_BUDGET_MICROSECONDS = 2000;
+
+		// served in this order, oldest first among requests with the same priority
+		enum class Priority {
+			PLAYER, //orders the player gave
+			AI,
+			SCOUTING, //nobody is waiting on these
+		};
+
+		// how the main thread searches have been keeping to the budget
+		struct BudgetStats {
+			unsigned int ticks = 0; //updates that searched anything
+			unsigned int overruns = 0; //of those, the ones that took longer than the budget
+			long long worstOverrunMicroseconds = 0;
+			long long lastTickMicroseconds = 0;
+			unsigned int suspended = 0; //times a search ran out of time and was left for the next tick
+		};
+
+		// starts the worker threads, 0 picks one less than the number of cores (so none on a single core).
+		// without workers requests are searched in update, within the budget
+		void init(unsigned int workerCount = 0);
+
+		// stops the workers, anything still queued is dropped
+		void shutdown();
+
+		RequestId request(const glm::vec3& start, const glm::vec3& goal, const aStar::PathOptions& options,
+						  Priority priority = Priority::AI);
+
+		// drops the request whether it has been solved yet or not, safe to call with a finished or unknown id
+		void cancel(RequestId id);
+
+		// call once per tick on the main thread before entities look for their results. results that weren't
+		// taken since the last update are dropped
+		void update();
+
+		/* true if the result for id was delivered, the result is moved out and the id is done.
+		except for WEIGHTED requests that found a path: better paths can show up for the same id on later ticks, until it
+		is cancelled or the best path was found. they are only searched for when the queue is empty*/
+		bool takeResult(RequestId id, std::pair<bool, std::vector<glm::vec3>>& result);
+
+		// requests that haven't been delivered yet
+		int pendingCount();
+
+		// how long each update may spend searching when there are no workers. the clock is only looked at every
+		// few hundred expanded cells, so ticks can go a little over
+		void setBudget(int microseconds);
+
+		const BudgetStats& budgetStats();
+	}
+}
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <array>
+#include "regions.hpp"
+
+namespace AI {
+	namespace regions {
+		const std::array<std::pair<int, int>, 4> sides = {{{0, 1}, {0, -1}, {1, 0}, {-1, 0}}};
+
+		/* diagonal steps need both straight neighbours open, so they never join cells that straight steps
+		don't already join. that's why only the 4 straight neighbours are looked at*/
+		void labelBlock(NavGrid::Grid& grid, int block, std::vector<int>& stack) {
+			int minCol = (block % grid.regionBlocksWide) * BLOCK_SIZE;
+			int minRow = (block / grid.regionBlocksWide) * BLOCK_SIZE;
+			int maxCol = std::min(minCol + BLOCK_SIZE, grid.width) - 1;
+			int maxRow = std::min(minRow + BLOCK_SIZE, grid.height) - 1;
+
+			for (int row = minRow; row <= maxRow; row++) {
+				for (int col = minCol; col <= maxCol; col++) {
+					grid.components[grid.index(col, row)] = -1;
+				}
+			}
+
+			int component = block * MAX_COMPONENTS_PER_BLOCK;
+			for (int row = minRow; row <= maxRow; row++) {
+				for (int col = minCol; col <= maxCol; col++) {
+					int cell = grid.index(col, row);
+					if (grid.isObstacle(cell) || grid.components[cell] >= 0) {
+						continue;
+					}
+
+					//flood the piece this cell is in without leaving the block
+					grid.components[cell] = component;
+					stack.push_back(cell);
+					while (!stack.empty()) {
+						int current = stack.back();
+						stack.pop_back();
+						for (const auto& side : sides) {
+							int nextCol = grid.colOf(current) + side.first, nextRow = grid.rowOf(current) + side.second;
+							if (nextCol < minCol || nextCol > maxCol || nextRow < minRow || nextRow > maxRow) {
+								continue;
+							}
+							int next = grid.index(nextCol, nextRow);
+							if (!grid.isObstacle(next) && grid.components[next] < 0) {
+								grid.components[next] = component;
+								stack.push_back(next);
+							}
+						}
+					}
+					component++;
+				}
+			}
+		}
+
+		int findRoot(std::vector<int>& parents, int component) {
+			while (parents[component] != component) {
+				parents[component] = parents[parents[component]];
+				component = parents[component];
+			}
+			return component;
+		}
+
+		// joins pieces that touch across block borders, only the cells along the borders have to be looked at
+		void joinBlocks(NavGrid::Grid& grid) {
+			std::vector<int>& parents = grid.componentRegions;
+			for (int i = 0; i < (int) parents.size(); i++) {
+				parents[i] = i;
+			}
+			auto join = [&](int cell, int other) {
+				int a = grid.components[cell], b = grid.components[other];
+				if (a >= 0 && b >= 0) {
+					a = findRoot(parents, a);
+					b = findRoot(parents, b);
+					if (a != b) {
+						parents[std::max(a, b)] = std::min(a, b);
+					}
+				}
+			};
+
+			for (int col = BLOCK_SIZE - 1; col + 1 < grid.width; col += BLOCK_SIZE) {
+				for (int row = 0; row < grid.height; row++) {
+					join(grid.index(col, row), grid.index(col + 1, row));
+				}
+			}
+			for (int row = BLOCK_SIZE - 1; row + 1 < grid.height; row += BLOCK_SIZE) {
+				for (int col = 0; col < grid.width; col++) {
+					join(grid.index(col, row), grid.index(col, row + 1));
+				}
+			}
+			for (int i = 0; i < (int) parents.size(); i++) {
+				parents[i] = findRoot(parents, i);
+			}
+		}
+
+		void build(NavGrid::Grid& grid) {
+			grid.regionBlocksWide = (grid.width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+			int blocksHigh = (grid.height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+			grid.components.assign(grid.cellCount(), -1);
+			grid.componentRegions.assign(grid.regionBlocksWide * blocksHigh * MAX_COMPONENTS_PER_BLOCK, NO_REGION);
+
+			std::vector<int> stack;
+			for (int block = 0; block < grid.regionBlocksWide * blocksHigh; block++) {
+				labelBlock(grid, block, stack);
+			}
+			joinBlocks(grid);
+		}
+
+		void updateArea(NavGrid::Grid& grid, int minCol, int minRow, int maxCol, int maxRow) {
+			std::vector<int> stack;
+			for (int blockRow = minRow / BLOCK_SIZE; blockRow <= maxRow / BLOCK_SIZE; blockRow++) {
+				for (int blockCol = minCol / BLOCK_SIZE; blockCol <= maxCol / BLOCK_SIZE; blockCol++) {
+					labelBlock(grid, blockRow * grid.regionBlocksWide + blockCol, stack);
+				}
+			}
+			joinBlocks(grid);
+		}
+
+		int regionOf(const NavGrid::Grid& grid, int cell) {
+			int component = grid.components[cell];
+			return component < 0 ? NO_REGION : grid.componentRegions[component];
+		}
+
+		// the regions a cell can be stepped onto from, or stepped off to if it's where the search starts.
+		// open cells only have their own, obstacles have the regions of the open cells next to them
+		int regionsAround(const NavGrid::Grid& grid, int cell, std::array<int, 4>& regions) {
+			if (!grid.isObstacle(cell)) {
+				regions[0] = regionOf(grid, cell);
+				return 1;
+			}
+			int count = 0;
+			for (const auto& side : sides) {
+				int col = grid.colOf(cell) + side.first, row = grid.rowOf(cell) + side.second;
+				if (grid.withinBounds(col, row) && !grid.isObstacle(grid.index(col, row))) {
+					regions[count++] = regionOf(grid, grid.index(col, row));
+				}
+			}
+			return count;
+		}
+
+		bool canReach(const NavGrid::Grid& grid, int fromCell, int toCell) {
+			if (grid.components.empty()) {
+				return true; //never labelled, let the search find out
+			}
+			int colDiff = std::abs(grid.colOf(fromCell) - grid.colOf(toCell));
+			int rowDiff = std::abs(grid.rowOf(fromCell) - grid.rowOf(toCell));
+			if (colDiff <= 1 && rowDiff <= 1) {
+				return true; //one step, close enough to leave to the search even between two obstacles
+			}
+
+			std::array<int, 4> fromRegions, toRegions;
+			int fromCount = regionsAround(grid, fromCell, fromRegions);
+			int toCount = regionsAround(grid, toCell, toRegions);
+			for (int i = 0; i < fromCount; i++) {
+				for (int j = 0; j < toCount; j++) {
+					if (fromRegions[i] == toRegions[j]) {
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		int nearestReachableCell(const NavGrid::Grid& grid, int fromCell, int cell) {
+			int col = grid.colOf(cell), row = grid.rowOf(cell);
+			if (!grid.isObstacle(cell) && canReach(grid, fromCell, cell)) {
+				return cell;
+			}
+
+			//look at squares of growing size around the cell. a cell on ring n is between n and n * sqrt(2) away,
+			//so once n passes the closest one found so far nothing further out can beat it
+			int best = -1, bestDistance = 0;
+			int maxRing = std::max(grid.width, grid.height);
+			for (int ring = 1; ring <= maxRing && (best < 0 || ring * ring <= bestDistance); ring++) {
+				for (int dRow = -ring; dRow <= ring; dRow++) {
+					int step = (dRow == -ring || dRow == ring) ? 1 : 2 * ring; //only the edges of the square
+					for (int dCol = -ring; dCol <= ring; dCol += step) {
+						int nextCol = col + dCol, nextRow = row + dRow;
+						if (!grid.withinBounds(nextCol, nextRow)) {
+							continue;
+						}
+						int next = grid.index(nextCol, nextRow);
+						int distance = dCol * dCol + dRow * dRow;
+						if ((best < 0 || distance < bestDistance) && !grid.isObstacle(next) && canReach(grid, fromCell, next)) {
+							best = next;
+							bestDistance = distance;
+						}
+					}
+				}
+			}
+			return best;
+		}
+	}
+}
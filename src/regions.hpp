@@ -0,0 +1,31 @@
+#pragma once
+
+#include "navgrid.hpp"
+
+/* connected regions of the level, two cells share a region if a unit can walk from one to the other.
+every block of the level labels the connected pieces of open cells inside it, and pieces touching across
+block borders are joined into regions. placing a building only relabels the blocks it is in and rejoins the
+pieces, so asking whether a goal can be reached at all never needs a search*/
+namespace AI {
+	namespace regions {
+		const int BLOCK_SIZE = 16;
+		const int MAX_COMPONENTS_PER_BLOCK = BLOCK_SIZE * BLOCK_SIZE / 2; //a checkerboard of open cells
+		const int NO_REGION = -1;
+
+		// labels the whole grid, call whenever the whole grid is replaced
+		void build(NavGrid::Grid& grid);
+
+		// relabels the blocks overlapping the (inclusive) area after the grid costs there changed
+		void updateArea(NavGrid::Grid& grid, int minCol, int minRow, int maxCol, int maxRow);
+
+		// NO_REGION for obstacles
+		int regionOf(const NavGrid::Grid& grid, int cell);
+
+		/* false only if no search from fromCell could ever get to toCell. follows the same rules as the searches:
+		the goal can be an obstacle as long as we can get next to it, and a start inside an obstacle can step out of it*/
+		bool canReach(const NavGrid::Grid& grid, int fromCell, int toCell);
+
+		// the open cell closest to cell (by straight line distance) that can be reached from fromCell, -1 if there is none
+		int nearestReachableCell(const NavGrid::Grid& grid, int fromCell, int cell);
+	}
+}
@@ -7,6 +7,11 @@ RigidBody::RigidBody(glm::vec3 _position, glm::vec3 _size, glm::vec3 _velocity)
     geometryId = Model::collisionDetector.createBoundingBox(_position, _size, _velocity);
 }
 
+RigidBody::RigidBody(WithoutGeometry)
+{
+	geometryId = CollisionDetector::NO_BOX;
+}
+
 void RigidBody::setVelocity(glm::vec3 _velocity)
 {
     this->velocity = _velocity;
@@ -119,6 +124,11 @@ void RigidBody::setCollisionGeometryType(CollisionGeomType _cg)
     this->cgType = _cg; // Todo: doesnt actually affect bounding box
 }
 
+void RigidBody::setContinuous(bool continuous)
+{
+	Model::collisionDetector.setContinuous(geometryId, continuous);
+}
+
 CollisionGeomType RigidBody::getCollisionGeometryType()
 {
     return this->cgType;
@@ -156,7 +166,17 @@ std::vector<CollisionDetection::CollisionInfo> RigidBody::getAllCollisions()
 	return Model::collisionDetector.getAllCollisions(geometryId);
 }
 
+bool RigidBody::hasContact()
+{
+	return Model::collisionDetector.hasContact(geometryId);
+}
+
 CollisionDetection::CollisionInfo RigidBody::getFirstCollision()
 {
 	return Model::collisionDetector.getFirstCollision(geometryId);
 }
+
+CollisionDetection::CollisionInfo RigidBody::getFirstImpact()
+{
+	return Model::collisionDetector.getFirstImpact(geometryId);
+}
@@ -28,8 +28,13 @@ enum class CollisionGeomType {
 
 class RigidBody {
 public:
+	// for things that never collide, eg tiles. no box is created, collision queries come back empty
+	struct WithoutGeometry {};
+
 	RigidBody(glm::vec3 _position = {0, 0, 0}, glm::vec3 _size = {1, 0, 1}, glm::vec3 _velocity = {0, 0, 0});
 
+	RigidBody(WithoutGeometry);
+
 	void setVelocity(glm::vec3);
 
 	void setGravity(glm::vec3);
@@ -50,6 +55,8 @@ public:
 
 	void setCollisionGeometryType(CollisionGeomType);
 
+	void setContinuous(bool); //see CollisionDetector::setContinuous
+
 	glm::vec3 getPosition() const;
 
 	float getRotation(glm::vec3);
@@ -74,8 +81,12 @@ public:
 
 	std::vector<CollisionDetection::CollisionInfo> getAllCollisions();
 
+	bool hasContact(); //getAllCollisions().empty() without the copy
+
 	CollisionDetection::CollisionInfo getFirstCollision();
 
+	CollisionDetection::CollisionInfo getFirstImpact();
+
 protected:
 	// this is 1/mass, a better representation that 
 	// allows us to work with 0 and infinite masses
@@ -0,0 +1,267 @@
+#include "staticbvh.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace {
+	const float NO_HIT = std::numeric_limits<float>::infinity();
+
+	// where start + delta * t for t from 0 to tMax first touches box, false if it never does
+	bool clip(const BoundingBox& box, glm::vec3 start, glm::vec3 delta, float tMax, float& enter) {
+		const float starts[2] = {start.x, start.z}, deltas[2] = {delta.x, delta.z};
+		const float mins[2] = {box.lowerCorner.x, box.lowerCorner.z}, maxs[2] = {box.upperCorner.x, box.upperCorner.z};
+		float low = 0, high = tMax;
+		for (int axis = 0; axis < 2; axis++) {
+			if (deltas[axis] == 0.0f) {
+				if (starts[axis] < mins[axis] || starts[axis] > maxs[axis]) {
+					return false;
+				}
+				continue;
+			}
+			float inverse = 1.0f / deltas[axis];
+			float toMin = (mins[axis] - starts[axis]) * inverse, toMax = (maxs[axis] - starts[axis]) * inverse;
+			low = std::max(low, std::min(toMin, toMax));
+			high = std::min(high, std::max(toMin, toMax));
+			if (low > high) {
+				return false;
+			}
+		}
+		enter = low;
+		return true;
+	}
+
+	BoundingBox merged(const BoundingBox& a, const BoundingBox& b) {
+		return {glm::min(a.lowerCorner, b.lowerCorner), glm::max(a.upperCorner, b.upperCorner)};
+	}
+
+	glm::vec3 centre(const BoundingBox& box) {
+		return (box.lowerCorner + box.upperCorner) / 2.0f;
+	}
+}
+
+const unsigned StaticBvh::ALL_LAYERS;
+const int StaticBvh::NO_ITEM;
+
+void StaticBvh::insert(int item, const BoundingBox& box, unsigned layers)
+{
+	auto found = entryOf.find(item);
+	if (found != entryOf.end()) {
+		entries[found->second] = {item, CollisionDetection::normalizeBoundingBox(box), layers};
+	} else {
+		entryOf[item] = (int) entries.size();
+		entries.push_back({item, CollisionDetection::normalizeBoundingBox(box), layers});
+	}
+	stale = true;
+}
+
+void StaticBvh::remove(int item)
+{
+	auto found = entryOf.find(item);
+	if (found == entryOf.end()) {
+		return;
+	}
+	int entry = found->second;
+	entryOf.erase(found);
+	if (entry != (int) entries.size() - 1) {
+		entries[entry] = entries.back();
+		entryOf[entries[entry].item] = entry;
+	}
+	entries.pop_back();
+	stale = true;
+}
+
+bool StaticBvh::contains(int item) const
+{
+	return entryOf.count(item) > 0;
+}
+
+void StaticBvh::clear()
+{
+	entries.clear();
+	entryOf.clear();
+	nodes.clear();
+	stale = false;
+}
+
+int StaticBvh::size() const
+{
+	return (int) entries.size();
+}
+
+void StaticBvh::refresh()
+{
+	if (stale) {
+		rebuild();
+	}
+}
+
+void StaticBvh::rebuild()
+{
+	nodes.clear();
+	if (!entries.empty()) {
+		build(0, (int) entries.size());
+	}
+	for (int i = 0; i < (int) entries.size(); i++) {
+		entryOf[entries[i].item] = i; //building moved them about
+	}
+	stale = false;
+}
+
+int StaticBvh::build(int first, int end)
+{
+	int node = (int) nodes.size();
+	nodes.emplace_back();
+	BoundingBox box = entries[first].box, centres = {centre(box), centre(box)};
+	unsigned layers = 0;
+	for (int i = first; i < end; i++) {
+		box = merged(box, entries[i].box);
+		glm::vec3 middle = centre(entries[i].box);
+		centres = merged(centres, {middle, middle});
+		layers |= entries[i].layers;
+	}
+	nodes[node].box = box;
+	nodes[node].layers = layers;
+	if (end - first <= LEAF_SIZE) {
+		nodes[node].first = first;
+		nodes[node].count = end - first;
+		return node;
+	}
+
+	// half the boxes on either side of the median centre along the wider side
+	glm::vec3 extent = centres.upperCorner - centres.lowerCorner;
+	bool alongX = extent.x >= extent.z;
+	int middle = (first + end) / 2;
+	std::nth_element(entries.begin() + first, entries.begin() + middle, entries.begin() + end,
+					 [alongX](const Entry& a, const Entry& b) {
+						 glm::vec3 centreA = centre(a.box), centreB = centre(b.box);
+						 return alongX ? centreA.x < centreB.x : centreA.z < centreB.z;
+					 });
+	build(first, middle);
+	int right = build(middle, end);
+	nodes[node].right = right;
+	return node;
+}
+
+StaticBvh::Hit StaticBvh::firstHit(const CollisionDetection::LineSegment& segment, unsigned layers)
+{
+	std::vector<Hit> hits;
+	firstHits({segment}, hits, layers);
+	return hits[0];
+}
+
+StaticBvh::Hit StaticBvh::firstHit(glm::vec3 origin, glm::vec3 direction, unsigned layers)
+{
+	refresh();
+	Hit hit = {NO_ITEM, NO_HIT};
+	stack.clear();
+	if (!nodes.empty()) {
+		stack.push_back(0);
+	}
+	while (!stack.empty()) {
+		int index = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[index];
+		float enter;
+		if (!(node.layers & layers) || !clip(node.box, origin, direction, NO_HIT, enter) || enter >= hit.t) {
+			continue;
+		}
+		if (node.count == 0) {
+			stack.push_back(node.right);
+			stack.push_back(index + 1);
+			continue;
+		}
+		for (int i = node.first; i < node.first + node.count; i++) {
+			if ((entries[i].layers & layers) && clip(entries[i].box, origin, direction, NO_HIT, enter) && enter < hit.t) {
+				hit = {entries[i].item, enter};
+			}
+		}
+	}
+	return hit;
+}
+
+bool StaticBvh::anyHit(const CollisionDetection::LineSegment& segment, unsigned layers)
+{
+	std::vector<Hit> hits;
+	firstHits({segment}, hits, layers, true);
+	return hits[0].item != NO_ITEM;
+}
+
+void StaticBvh::firstHits(const std::vector<CollisionDetection::LineSegment>& segments, std::vector<Hit>& hits,
+						  unsigned layers, bool stopAtAny)
+{
+	refresh();
+	hits.assign(segments.size(), {NO_ITEM, NO_HIT});
+	if (nodes.empty() || segments.empty()) {
+		return;
+	}
+	std::vector<int> active((int) segments.size());
+	for (int i = 0; i < (int) active.size(); i++) {
+		active[i] = i;
+	}
+	batchFirstHits(0, segments, hits, active.data(), (int) active.size(), layers, stopAtAny);
+}
+
+void StaticBvh::batchFirstHits(int index, const std::vector<CollisionDetection::LineSegment>& segments,
+							   std::vector<Hit>& hits, int* active, int count, unsigned layers, bool stopAtAny)
+{
+	const Node& node = nodes[index];
+	if (!(node.layers & layers)) {
+		return;
+	}
+	// the segments that reach this node go to the front, the rest are done with everything under it
+	int reaching = 0;
+	for (int i = 0; i < count; i++) {
+		int segment = active[i];
+		float enter;
+		bool done = stopAtAny && hits[segment].item != NO_ITEM;
+		if (!done && clip(node.box, segments[segment].start, segments[segment].end - segments[segment].start, 1.0f, enter) &&
+				enter < hits[segment].t) {
+			std::swap(active[i], active[reaching++]);
+		}
+	}
+	if (reaching == 0) {
+		return;
+	}
+	if (node.count == 0) {
+		batchFirstHits(index + 1, segments, hits, active, reaching, layers, stopAtAny);
+		batchFirstHits(node.right, segments, hits, active, reaching, layers, stopAtAny);
+		return;
+	}
+	for (int i = 0; i < reaching; i++) {
+		int segment = active[i];
+		glm::vec3 start = segments[segment].start, delta = segments[segment].end - start;
+		for (int j = node.first; j < node.first + node.count && !(stopAtAny && hits[segment].item != NO_ITEM); j++) {
+			float enter;
+			if ((entries[j].layers & layers) && clip(entries[j].box, start, delta, 1.0f, enter) && enter < hits[segment].t) {
+				hits[segment] = {entries[j].item, enter};
+			}
+		}
+	}
+}
+
+void StaticBvh::overlapping(const BoundingBox& box, std::vector<int>& items, unsigned layers)
+{
+	refresh();
+	BoundingBox query = CollisionDetection::normalizeBoundingBox(box);
+	stack.clear();
+	if (!nodes.empty()) {
+		stack.push_back(0);
+	}
+	while (!stack.empty()) {
+		int index = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[index];
+		if (!(node.layers & layers) || !CollisionDetection::aabbsOverlap(node.box, query)) {
+			continue;
+		}
+		if (node.count == 0) {
+			stack.push_back(node.right);
+			stack.push_back(index + 1);
+			continue;
+		}
+		for (int i = node.first; i < node.first + node.count; i++) {
+			if ((entries[i].layers & layers) && CollisionDetection::aabbsOverlap(entries[i].box, query)) {
+				items.push_back(entries[i].item);
+			}
+		}
+	}
+}
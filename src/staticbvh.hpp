@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "collisiondetection.hpp"
+
+/*
+Bounding volume hierarchy over boxes that don't move, eg buildings, trees and water. only x and z matter, like in the
+collision detector. built top down, splitting the wider side of the box centres at the median until a few boxes are left.
+adding and removing boxes just marks the tree stale, it's rebuilt the next time something is asked. tiles change when
+something is built, which is rare next to the area and placement checks made every tick
+
+Every box has a mask of layers and queries only look at boxes in the layers they ask for, so ground and obstacles can
+share one tree. nodes keep the layers of everything under them and are skipped when none match
+*/
+class StaticBvh {
+public:
+	static const unsigned ALL_LAYERS = ~0u;
+	static const int NO_ITEM = -1;
+
+	struct Hit {
+		int item; //NO_ITEM if nothing was hit
+		float t; //fraction along the segment where it first touches the box, 0 if it starts inside, infinity for no hit
+	};
+
+private:
+	static const int LEAF_SIZE = 4;
+
+	struct Entry {
+		int item;
+		BoundingBox box; //normalised
+		unsigned layers;
+	};
+
+	struct Node {
+		BoundingBox box; //around everything under it
+		unsigned layers = 0;
+		int first = 0, count = 0; //entries of a leaf, count is 0 for inner nodes
+		int right = 0; //inner nodes only, the left child comes right after its parent
+	};
+
+	std::vector<Entry> entries; //grouped by leaf once built
+	std::unordered_map<int, int> entryOf; //item -> where it is in entries
+	std::vector<Node> nodes;
+	bool stale = false;
+
+	std::vector<int> stack; //scratch for walking the tree
+
+	void rebuild();
+	int build(int first, int end);
+	void refresh(); //rebuilds if anything changed since the last query
+
+	// walks the tree for a batch of segments at once, active are the ones still looking for a hit under node
+	void batchFirstHits(int node, const std::vector<CollisionDetection::LineSegment>& segments, std::vector<Hit>& hits,
+						int* active, int count, unsigned layers, bool stopAtAny);
+
+public:
+	// adding an item that's already there moves it
+	void insert(int item, const BoundingBox& box, unsigned layers = ALL_LAYERS);
+
+	// nothing for items that aren't there
+	void remove(int item);
+
+	bool contains(int item) const;
+
+	void clear();
+
+	int size() const;
+
+	// the first box in layers the segment touches, edges and corners count
+	Hit firstHit(const CollisionDetection::LineSegment& segment, unsigned layers = ALL_LAYERS);
+
+	// the same for a ray, t is in lengths of direction
+	Hit firstHit(glm::vec3 origin, glm::vec3 direction, unsigned layers = ALL_LAYERS);
+
+	// whether the segment touches anything in layers at all, cheaper than firstHit
+	bool anyHit(const CollisionDetection::LineSegment& segment, unsigned layers = ALL_LAYERS);
+
+	// many segments at once, hits[i] is for segments[i]. the tree is walked once for all of them. with stopAtAny a hit is
+	// any box the segment touches instead of the first
+	void firstHits(const std::vector<CollisionDetection::LineSegment>& segments, std::vector<Hit>& hits,
+				   unsigned layers = ALL_LAYERS, bool stopAtAny = false);
+
+	// items of the boxes in layers overlapping box, not just touching it, in no particular order. appended to items
+	void overlapping(const BoundingBox& box, std::vector<int>& items, unsigned layers = ALL_LAYERS);
+};
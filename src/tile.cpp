@@ -110,10 +110,8 @@ void GunTowerTile::attack(const std::shared_ptr<Entity>& entityToAttack, double
 	}
 }
 
-Tile::Tile(Model::MeshType mesh) : Entity(mesh) {
-	hasPhysics = false;
+Tile::Tile(Model::MeshType mesh) : Entity(mesh, RigidBody::WithoutGeometry()) {
 	type = mesh;
-	rigidBody.removeSelf();
 }
 void Tile::update(double ms)
 {
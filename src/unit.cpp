@@ -4,6 +4,11 @@
 
 #include "unit.hpp"
 
+namespace {
+	// cells per second, about half a unit per tick at 30 fps. faster units could skip past each other between passes
+	const int CONTINUOUS_COLLISION_SPEED = 15;
+}
+
 // Sets AI comp and Unit comp
 void initUnitFromMeshType(const std::shared_ptr<Entity>& e, Model::MeshType type, GamePieceOwner owner) {
 	switch (type) {
@@ -88,12 +93,15 @@ void initUnitFromMeshType(const std::shared_ptr<Entity>& e, Model::MeshType type
 			throw "Uninitializable unit encountered in initUnitFromMeshType";
 	}
 
+	e->rigidBody.setContinuous(e->unitComp.movementSpeed >= CONTINUOUS_COLLISION_SPEED);
 	e->aiComp.owner = owner;
 
 	if (owner == GamePieceOwner::PLAYER) {
+		e->pathOptions.mode = AI::aStar::SearchMode::INCREMENTAL; //the player builds while their units walk
 		Global::playerUnits.push_back(e);
 
 	} else if (owner == GamePieceOwner::AI) {
+		e->pathOptions.mode = AI::aStar::SearchMode::COOPERATIVE; //the ai moves its units in groups
 		Global::aiUnits.push_back(e);
 	}
 }
@@ -26,6 +26,9 @@ public:
 	UnitState state;
 	std::vector<glm::vec3> targetPath;
 	double targetPathStartTimestamp = 0; //needed to get delta time
+	int targetPathSegment = 0; //waypoint the unit last walked past, paths can have long straight stretches between them
+	float targetPathSegmentStart = 0; //distance walked along the path when it got there
+	std::vector<float> targetPathTimes; //ms after the start each waypoint is reached at, for timed paths. empty otherwise
 
 	UnitComp() : initialEnergyLevel(50),
 				 attackDamage(1),
@@ -56,6 +59,9 @@ public:
 			   currentEnergyLevel == rhs.currentEnergyLevel &&
 			   state == rhs.state &&
 			   targetPath == rhs.targetPath &&
-			   targetPathStartTimestamp == rhs.targetPathStartTimestamp;
+			   targetPathStartTimestamp == rhs.targetPathStartTimestamp &&
+			   targetPathSegment == rhs.targetPathSegment &&
+			   targetPathSegmentStart == rhs.targetPathSegmentStart &&
+			   targetPathTimes == rhs.targetPathTimes;
 	}
 };
@@ -4,6 +4,10 @@
 
 #include <complex>
 #include "unitmanager.hpp"
+#include "cooperative.hpp"
+#include "landmarks.hpp"
+#include "pathindex.hpp"
+#include "regions.hpp"
 
 namespace UnitManager {
 
@@ -53,6 +57,19 @@ namespace UnitManager {
 
 	void update(double elapsed_ms) {
 		removeDead();
+		AI::cooperative::reservations.advance(elapsed_ms);
+		AI::pathRequests::update(); //paths finished since the last tick get picked up in move
+		AI::landmarks::landmarks.repair(AI::NavGrid::grid); //tables go out of date as buildings go up
+
+		static std::vector<Entity*> affected;
+		AI::pathIndex::takeAffected(AI::NavGrid::grid, affected); //only units with a building in their way search again
+		for (Entity* entity : affected) {
+			entity->needsRepath = true;
+		}
+
+		//nothing moves until everybody has worked out where they're going, so the pass can run alongside that
+		Model::collisionDetector.beginCollisions(elapsed_ms);
+
 		int currentUnixTime = (int) getUnixTime();
 		for (auto& playerUnit : Global::playerUnits) {
 			playerUnit->unitComp.update();
@@ -68,7 +85,7 @@ namespace UnitManager {
 					aiUnit->getPosition().x + 0.5)] = Config::OBSTACLE_COST;
 		}
 
-		Model::collisionDetector.findCollisions(elapsed_ms);
+		Model::collisionDetector.finishCollisions();
 
 		for (auto& playerUnit : Global::playerUnits) {
 			playerUnit->move(elapsed_ms);
@@ -185,17 +202,60 @@ namespace UnitManager {
 		} else { // no unit found, so attackMove to that location
 			position = targetLocation;
 		}
+
+		// a click on water or into a walled off pocket sends the units as close as they can get instead
+		const AI::NavGrid::Grid& grid = AI::NavGrid::grid;
+		int fromCell = -1;
+		if (!selectedUnits.empty()) {
+			Coord from = selectedUnits.front()->getPositionInt();
+			int col = int(position.x + 0.5), row = int(position.z + 0.5);
+			if (grid.withinBounds(from.colCoord, from.rowCoord) && grid.withinBounds(col, row)) {
+				fromCell = grid.index(from.colCoord, from.rowCoord);
+				int cell = grid.index(col, row);
+				int nearest = AI::regions::canReach(grid, fromCell, cell) ? cell : AI::regions::nearestReachableCell(grid, fromCell, cell);
+				if (nearest >= 0 && nearest != cell) {
+					position = glm::vec3(grid.colOf(nearest), position.y, grid.rowOf(nearest));
+				}
+			}
+		}
+		auto isReachable = [&](const glm::vec3& spot) {
+			int col = int(spot.x + 0.5), row = int(spot.z + 0.5);
+			return fromCell < 0 || (grid.withinBounds(col, row) && AI::regions::canReach(grid, fromCell, grid.index(col, row)));
+		};
+
 		int n = 0;
 		int nCutoff = 10; // We give up at that point
-		for (auto& unit : selectedUnits) {
+		std::vector<glm::vec3> specificPositions;
+		for (size_t i = 0; i < selectedUnits.size(); i++) {
 			glm::vec3 specificPosition = position + spiralOffset(n);
-			while (!AI::aStar::isTraversable(specificPosition.x, specificPosition.z) && n < nCutoff) {
+			while ((!AI::aStar::isTraversable(specificPosition.x, specificPosition.z) || !isReachable(specificPosition)) &&
+				   n < nCutoff) {
 				n++;
 				specificPosition = position + spiralOffset(n);
 			}
-			unit->moveTo(UnitState::ATTACK_MOVE, specificPosition, queueCommand);
+			specificPositions.push_back(specificPosition);
 			n++;
 		}
+
+		if ((int) selectedUnits.size() < AI::flowField::MIN_GROUP_SIZE) {
+			for (size_t i = 0; i < selectedUnits.size(); i++) {
+				selectedUnits[i]->moveTo(UnitState::ATTACK_MOVE, specificPositions[i], queueCommand);
+			}
+			return;
+		}
+
+		// one flow field into the area the group spreads out over, instead of a search per unit
+		std::vector<int> goalCells;
+		for (const glm::vec3& specificPosition : specificPositions) {
+			int col = int(specificPosition.x + 0.5), row = int(specificPosition.z + 0.5);
+			if (grid.withinBounds(col, row)) {
+				goalCells.push_back(grid.index(col, row));
+			}
+		}
+		std::shared_ptr<const AI::flowField::FlowField> field = AI::flowField::getField(goalCells);
+		for (size_t i = 0; i < selectedUnits.size(); i++) {
+			selectedUnits[i]->moveToWithFlowField(UnitState::ATTACK_MOVE, specificPositions[i], field, queueCommand);
+		}
 	}
 
 	void sortSelectedUnits() {
@@ -95,6 +95,9 @@ bool World::init() {
 	Global::levelArray = level.levelLoader(pathBuilder({"data", "levels"}) + "GameLevel1.txt");
 	Global::levelHeight = Global::levelArray.size();
 	Global::levelWidth = Global::levelArray.front().size();
+	AI::NavGrid::init(Global::levelTraversalCostMap);
+	AI::pathRequests::init();
+	Model::collisionDetector.startWorkers();
 	level.init(Model::meshRenderers);
 
 	UnitManager::init(Global::levelHeight, Global::levelWidth);
@@ -160,6 +163,8 @@ bool World::loadSkybox(const std::string& skyboxFilename, const std::string& sky
 
 // Releases all the associated resources
 void World::destroy() {
+	AI::pathRequests::shutdown();
+	Model::collisionDetector.stopWorkers();
 
 	m_skybox.destroy();
 	glfwDestroyWindow(m_window);
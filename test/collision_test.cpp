@@ -0,0 +1,505 @@
+#include <algorithm>
+#include <cstdlib>
+#include "catch.hpp"
+#include "aabbbatch.hpp"
+#include "collisiondetector.hpp"
+#include "staticbvh.hpp"
+
+namespace {
+	// collisions come out in whatever order the boxes are stored in
+	std::vector<glm::vec3> sorted(std::vector<glm::vec3> positions) {
+		std::sort(positions.begin(), positions.end(), [](const glm::vec3& a, const glm::vec3& b) {
+			return a.x < b.x || (a.x == b.x && a.z < b.z);
+		});
+		return positions;
+	}
+
+	// what the detector should report for box i: every live box overlapping it
+	std::vector<glm::vec3> overlapping(const std::vector<CollisionDetection::MovingBoundingBox>& boxes, size_t i) {
+		std::vector<glm::vec3> result;
+		for (size_t j = 0; j < boxes.size() && !boxes[i].removed; j++) {
+			if (i != j && !boxes[j].removed && CollisionDetection::aabbsOverlap(boxes[i], boxes[j])) {
+				result.push_back(boxes[j].position);
+			}
+		}
+		return sorted(result);
+	}
+
+	std::vector<glm::vec3> positionsOf(const std::vector<CollisionDetection::CollisionInfo>& collisions) {
+		std::vector<glm::vec3> result;
+		for (const auto& collision : collisions) {
+			result.push_back(collision.otherPos);
+		}
+		return sorted(result);
+	}
+
+	float randomCoordinate(float extent) {
+		return extent * float(std::rand()) / float(RAND_MAX);
+	}
+}
+
+TEST_CASE("The broadphase reports the same collisions as checking every pair", "[collision]") {
+	std::srand(42);
+	CollisionDetector detector;
+	std::vector<CollisionDetection::MovingBoundingBox> boxes; //the same boxes, checked the slow way
+	std::vector<int> ids;
+	for (int i = 0; i < 300; i++) {
+		glm::vec3 size = i % 50 == 0 ? glm::vec3(3, 0, 2) : glm::vec3(1, 0, 1); //a few buildings among the units
+		int id = detector.createBoundingBox({0, 0, 0}, size);
+		ids.push_back(id);
+		CollisionDetection::MovingBoundingBox box;
+		box.box = {-size / 2.0f, size / 2.0f};
+		box.position = {randomCoordinate(40), 0, randomCoordinate(40)};
+		box.velocity = {0, 0, 0};
+		boxes.push_back(box);
+		detector.setPosition(id, box.position);
+	}
+
+	for (int tick = 0; tick < 5; tick++) {
+		detector.findCollisions(16.0f);
+		for (size_t i = 0; i < boxes.size(); i++) {
+			REQUIRE(positionsOf(detector.getAllCollisions(ids[i])) == overlapping(boxes, i));
+			if (!boxes[i].removed) {
+				REQUIRE(detector.countCandidates(ids[i]) < 60); //a crowd of 300 on 40x40, nobody looks at everybody
+			}
+		}
+
+		//units walk about, some die
+		for (size_t i = 0; i < boxes.size(); i++) {
+			if (std::rand() % 40 == 0) {
+				boxes[i].removed = true;
+				detector.remove(ids[i]);
+			} else {
+				boxes[i].position += glm::vec3(randomCoordinate(2) - 1, 0, randomCoordinate(2) - 1);
+				detector.setPosition(ids[i], boxes[i].position);
+			}
+		}
+	}
+}
+
+TEST_CASE("Removed boxes give their slots to new ones and their old IDs stop working", "[collision]") {
+	CollisionDetector detector;
+	std::vector<int> ids;
+	for (int i = 0; i < 10; i++) {
+		ids.push_back(detector.createBoundingBox({0, 0, 0}, {1, 0, 1}));
+		detector.setPosition(ids.back(), {i * 0.75f, 0, 0}); //everybody overlaps their neighbours
+	}
+
+	//a row of tiles coming and going doesn't grow anything
+	for (int round = 0; round < 100; round++) {
+		int removed = ids[round % ids.size()];
+		detector.remove(removed);
+		detector.remove(removed); //twice is harmless
+		REQUIRE(!detector.isAlive(removed));
+		REQUIRE(detector.size() == 9);
+
+		int id = detector.createBoundingBox({0, 0, 0}, {1, 0, 1});
+		REQUIRE(id != removed);
+		REQUIRE(detector.isAlive(id));
+		REQUIRE(detector.size() == 10);
+
+		//the old ID doesn't reach the box that took its slot
+		int i = round % ids.size();
+		detector.setPosition(removed, {100, 0, 100});
+		detector.setPosition(id, {i * 0.75f, 0, 0});
+		ids[i] = id;
+		detector.findCollisions(16.0f);
+		REQUIRE(detector.getAllCollisions(removed).empty());
+		REQUIRE(!detector.getFirstCollision(removed).collided);
+		REQUIRE(detector.getFirstCollision(id).collided);
+	}
+
+	//boxes that were never made don't collide with anything either
+	REQUIRE(!detector.isAlive(CollisionDetector::NO_BOX));
+	REQUIRE(detector.getAllCollisions(CollisionDetector::NO_BOX).empty());
+	detector.setPosition(CollisionDetector::NO_BOX, {0, 0, 0});
+}
+
+TEST_CASE("Collision passes on workers find the same contacts in the same order as on one thread", "[collision]") {
+	std::srand(11);
+	std::vector<glm::vec3> positions;
+	for (int i = 0; i < 500; i++) {
+		positions.push_back({randomCoordinate(30), 0, randomCoordinate(30)}); //a big melee
+	}
+
+	auto contactsWith = [&](unsigned int workerCount) {
+		CollisionDetector detector;
+		if (workerCount > 0) {
+			detector.startWorkers(workerCount);
+		}
+		std::vector<int> ids;
+		for (const glm::vec3& position : positions) {
+			ids.push_back(detector.createBoundingBox({0, 0, 0}, {1, 0, 1}));
+			detector.setPosition(ids.back(), position);
+		}
+		std::vector<std::vector<glm::vec3>> contacts;
+		for (int tick = 0; tick < 3; tick++) {
+			detector.beginCollisions(16.0f);
+			for (int id : ids) {
+				detector.setVelocity(id, {1, 0, 0}); //units working out where to go while the pass runs
+			}
+			detector.finishCollisions();
+			for (int id : ids) {
+				std::vector<glm::vec3> found;
+				for (const auto& collision : detector.getAllCollisions(id)) {
+					found.push_back(collision.otherPos);
+				}
+				contacts.push_back(found);
+			}
+			detector.remove(ids[tick * 7]);
+			detector.setPosition(ids[tick * 11 + 1], {15, 0, 15});
+		}
+		return contacts;
+	};
+
+	auto alone = contactsWith(0);
+	REQUIRE(contactsWith(1) == alone);
+	REQUIRE(contactsWith(3) == alone);
+	REQUIRE(contactsWith(8) == alone);
+}
+
+TEST_CASE("Contact pairs are reported when they start touching, while they do and once they stop", "[collision]") {
+	typedef CollisionDetector::ContactEvent::Type Type;
+	CollisionDetector detector;
+	int a = detector.createBoundingBox({0, 0, 0}, {1, 0, 1});
+	int b = detector.createBoundingBox({0, 0, 0}, {1, 0, 1});
+	int c = detector.createBoundingBox({0, 0, 0}, {1, 0, 1});
+	detector.setPosition(a, {0, 0, 0});
+	detector.setPosition(b, {5, 0, 0});
+	detector.setPosition(c, {10, 0, 0});
+
+	auto eventsOf = [&](Type type) {
+		std::vector<std::pair<int, int>> pairs;
+		for (const CollisionDetector::ContactEvent& event : detector.contactEvents()) {
+			REQUIRE(event.id < event.otherId);
+			if (event.type == type) {
+				pairs.emplace_back(event.id, event.otherId);
+			}
+		}
+		return pairs;
+	};
+	typedef std::vector<std::pair<int, int>> Pairs;
+
+	detector.findCollisions(16.0f);
+	REQUIRE(detector.contactEvents().empty());
+	REQUIRE(!detector.hasContact(a));
+
+	detector.setPosition(b, {0.5f, 0, 0});
+	detector.findCollisions(16.0f);
+	REQUIRE(eventsOf(Type::ENTER) == Pairs{{a, b}});
+	REQUIRE(detector.hasContact(a));
+	REQUIRE(detector.hasContact(b));
+	REQUIRE(!detector.hasContact(c));
+	int visited = 0;
+	detector.forEachContact(a, [&](const CollisionDetector::Contact& contact) {
+		REQUIRE(contact.otherId == b);
+		REQUIRE(contact.info.otherPos == glm::vec3(0.5f, 0, 0));
+		visited++;
+	});
+	REQUIRE(visited == 1);
+
+	detector.setPosition(c, {1, 0, 0});
+	detector.findCollisions(16.0f);
+	REQUIRE(eventsOf(Type::STAY) == Pairs{{a, b}});
+	REQUIRE(eventsOf(Type::ENTER) == Pairs{{b, c}});
+	REQUIRE(eventsOf(Type::EXIT).empty());
+
+	//moving away and being removed both end a contact
+	detector.setPosition(a, {-5, 0, 0});
+	detector.remove(c);
+	detector.findCollisions(16.0f);
+	REQUIRE(eventsOf(Type::EXIT) == Pairs{{a, b}, {b, c}});
+	REQUIRE(eventsOf(Type::STAY).empty());
+	REQUIRE(!detector.hasContact(b));
+
+	detector.findCollisions(16.0f);
+	REQUIRE(detector.contactEvents().empty());
+}
+
+TEST_CASE("Fast boxes with continuous collision hit what they would jump over in one tick", "[collision]") {
+	BoundingBox unit = {{-0.5f, 0, -0.5f}, {0.5f, 0, 0.5f}};
+	BoundingBox wall = {{4.9f, 0, -2}, {5.1f, 0, 2}};
+
+	//straight at it, hits when the front edge reaches 4.9
+	CollisionDetection::CollisionInfo hit = CollisionDetection::sweptAabbCollision(unit, {10, 0, 0}, wall, {0, 0, 0}, 100.0f);
+	REQUIRE(hit.collided);
+	REQUIRE(hit.time == Approx(44.0f));
+	//the same thing from the wall's point of view
+	hit = CollisionDetection::sweptAabbCollision(wall, {-10, 0, 0}, unit, {0, 0, 0}, 100.0f);
+	REQUIRE(hit.time == Approx(44.0f));
+	//too slow to get there, or going past it
+	REQUIRE(!CollisionDetection::sweptAabbCollision(unit, {4, 0, 0}, wall, {0, 0, 0}, 100.0f).collided);
+	REQUIRE(!CollisionDetection::sweptAabbCollision(unit, {10, 0, 10}, wall, {0, 0, 0}, 100.0f).collided);
+
+	CollisionDetector detector;
+	int bullet = detector.createBoundingBox({0, 0, 0}, {1, 0, 1});
+	int slow = detector.createBoundingBox({0, 0, 0}, {1, 0, 1});
+	int thin = detector.createBoundingBox({0, 0, 0}, {0.2f, 0, 4});
+	int far = detector.createBoundingBox({0, 0, 0}, {0.2f, 0, 4});
+	detector.setPosition(bullet, {0, 0, 0});
+	detector.setPosition(slow, {0, 0, 10});
+	detector.setPosition(thin, {5, 0, 0});
+	detector.setPosition(far, {8, 0, 0});
+	detector.setContinuous(bullet, true);
+
+	//the same speed without continuous collision goes straight thru, overlap tests never see a thing
+	detector.beginCollisions(100.0f);
+	detector.setVelocity(bullet, {10, 0, 0});
+	detector.setVelocity(slow, {10, 0, 0});
+	detector.finishCollisions();
+	REQUIRE(!detector.hasContact(bullet));
+	REQUIRE(!detector.getFirstImpact(slow).collided);
+
+	//both walls are in the way, the nearer one comes first
+	const std::vector<CollisionDetector::Impact>& impacts = detector.getImpacts();
+	REQUIRE(impacts.size() == 2);
+	REQUIRE(impacts[0].id == bullet);
+	REQUIRE(impacts[0].otherId == thin);
+	REQUIRE(impacts[1].otherId == far);
+	REQUIRE(impacts[0].info.time < impacts[1].info.time);
+	CollisionDetection::CollisionInfo first = detector.getFirstImpact(bullet);
+	REQUIRE(first.collided);
+	REQUIRE(first.time == Approx(44.0f));
+	REQUIRE(first.otherPos == glm::vec3(5, 0, 0));
+
+	//impacts are only for the coming tick, nothing in the way means nothing
+	detector.setVelocity(bullet, {0, 0, 1});
+	detector.findCollisions(100.0f);
+	REQUIRE(detector.getImpacts().empty());
+	detector.setContinuous(bullet, false);
+	detector.setVelocity(bullet, {10, 0, 0});
+	detector.findCollisions(100.0f);
+	REQUIRE(!detector.getFirstImpact(bullet).collided);
+}
+
+TEST_CASE("Boxes that stand still fall asleep and wake when something touches or moves them", "[collision]") {
+	CollisionDetector detector;
+	detector.startWorkers(2);
+	//a block of idle units, all touching their neighbours
+	std::vector<int> idle;
+	for (int col = 0; col < 5; col++) {
+		for (int row = 0; row < 5; row++) {
+			idle.push_back(detector.createBoundingBox({0, 0, 0}, {1, 0, 1}));
+			detector.setPosition(idle.back(), {col * 0.9f, 0, row * 0.9f});
+		}
+	}
+	int walker = detector.createBoundingBox({0, 0, 0}, {1, 0, 1});
+	detector.setPosition(walker, {20, 0, 20});
+
+	auto touching = [&](int id) {
+		std::vector<int> others;
+		detector.forEachContact(id, [&](const CollisionDetector::Contact& contact) {
+			others.push_back(contact.otherId);
+		});
+		std::sort(others.begin(), others.end());
+		return others;
+	};
+
+	std::vector<std::vector<int>> awakeContacts;
+	for (int tick = 0; tick < 40; tick++) {
+		detector.beginCollisions(16.0f);
+		detector.setVelocity(walker, {0.1f, 0, 0});
+		detector.finishCollisions();
+		detector.setPosition(walker, {20 + tick * 0.1f, 0, 20});
+		if (tick == 0) {
+			for (int id : idle) {
+				awakeContacts.push_back(touching(id));
+			}
+		}
+	}
+	//asleep, they still know what they touch
+	REQUIRE(!detector.isAsleep(walker));
+	for (size_t i = 0; i < idle.size(); i++) {
+		REQUIRE(detector.isAsleep(idle[i]));
+		REQUIRE(touching(idle[i]) == awakeContacts[i]);
+	}
+	REQUIRE(detector.contactEvents().size() == 72); //diagonal neighbours too, all staying
+	for (const CollisionDetector::ContactEvent& event : detector.contactEvents()) {
+		REQUIRE(event.type == CollisionDetector::ContactEvent::Type::STAY);
+	}
+
+	//walking into the corner of the block, the walker finds the sleeping unit and the sleeping unit finds the walker
+	detector.setPosition(walker, {-0.8f, 0, -0.8f});
+	detector.findCollisions(16.0f);
+	REQUIRE(touching(walker) == std::vector<int>{idle[0]});
+	std::vector<int> expected = awakeContacts[0];
+	expected.push_back(walker);
+	std::sort(expected.begin(), expected.end());
+	REQUIRE(touching(idle[0]) == expected);
+	REQUIRE(!detector.isAsleep(idle[0]));
+	REQUIRE(detector.isAsleep(idle[1]));
+
+	//one being ordered off wakes it, and its old neighbours lose it
+	detector.setVelocity(idle[12], {0, 0, 1});
+	REQUIRE(!detector.isAsleep(idle[12]));
+	detector.setPosition(idle[12], {30, 0, 30});
+	detector.findCollisions(16.0f);
+	REQUIRE(touching(idle[12]).empty());
+	for (size_t i = 0; i < idle.size(); i++) {
+		std::vector<int> others = touching(idle[i]);
+		REQUIRE(std::find(others.begin(), others.end(), idle[12]) == others.end());
+	}
+	detector.stopWorkers();
+}
+
+TEST_CASE("Touching boxes that stop on different passes still fall asleep", "[collision]") {
+	CollisionDetector detector;
+	int first = detector.createBoundingBox({0, 0, 0}, {1, 0, 1});
+	int second = detector.createBoundingBox({0, 0, 0}, {1, 0, 1});
+	int third = detector.createBoundingBox({0, 0, 0}, {1, 0, 1});
+	detector.setPosition(first, {0, 0, 0});
+	detector.setPosition(third, {10, 0, 0});
+
+	//the second one walks up and stops leaning on the first, a few passes after the first stopped
+	for (int tick = 0; tick < 5; tick++) {
+		detector.setPosition(second, {0.9f - (4 - tick) * 0.1f, 0, 0.8f});
+		detector.findCollisions(16.0f);
+	}
+	int passes = 5;
+	while (passes < 200 && !(detector.isAsleep(first) && detector.isAsleep(second))) {
+		detector.findCollisions(16.0f);
+		passes++;
+		REQUIRE(detector.hasContact(first));
+		REQUIRE(detector.hasContact(second));
+	}
+	REQUIRE(passes < 50);
+
+	//something walking into them wakes them, their neighbours standing still doesn't
+	for (int tick = 0; tick < 10; tick++) {
+		detector.setPosition(third, {10 - tick * 1.05f, 0, -0.8f}); //passing below the second one
+		detector.findCollisions(16.0f);
+	}
+	REQUIRE(detector.hasContact(third));
+	REQUIRE(!detector.isAsleep(first));
+	REQUIRE(detector.isAsleep(second));
+}
+
+TEST_CASE("Batched overlap tests agree with aabbsOverlap, touching edges included", "[collision]") {
+	std::srand(7);
+	//half unit coordinates so plenty of boxes share an edge exactly
+	auto randomBox = []() {
+		BoundingBox box;
+		box.lowerCorner = {float(std::rand() % 20) / 2, 0, float(std::rand() % 20) / 2};
+		box.upperCorner = box.lowerCorner + glm::vec3(float(1 + std::rand() % 4) / 2, 0, float(1 + std::rand() % 4) / 2);
+		return box;
+	};
+
+	CollisionDetection::AabbArrays boxes;
+	std::vector<BoundingBox> unpacked;
+	for (int i = 0; i < 61; i++) { //not a whole number of batches, the padding mustn't overlap anything
+		unpacked.push_back(randomBox());
+		boxes.push_back(unpacked.back());
+	}
+	REQUIRE(boxes.size() == 61);
+	REQUIRE(boxes.minX.size() % CollisionDetection::AABB_BATCH == 0);
+
+	for (int test = 0; test < 200; test++) {
+		BoundingBox box = randomBox();
+		for (int first = 0; first < boxes.size(); first += CollisionDetection::AABB_BATCH) {
+			unsigned expected = 0;
+			for (int i = first; i < first + CollisionDetection::AABB_BATCH && i < boxes.size(); i++) {
+				expected |= unsigned(CollisionDetection::aabbsOverlap(box, unpacked[i])) << (i - first);
+			}
+			REQUIRE(CollisionDetection::overlapMaskScalar(box, boxes, first) == expected);
+			REQUIRE(CollisionDetection::overlapMask(box, boxes, first) == expected);
+		}
+	}
+
+	//taking boxes out keeps the rest where they were
+	boxes.swapRemove(3);
+	unpacked[3] = unpacked.back();
+	unpacked.pop_back();
+	REQUIRE(boxes.size() == 60);
+	for (int i = 0; i < boxes.size(); i++) {
+		REQUIRE(boxes.get(i).lowerCorner == unpacked[i].lowerCorner);
+		REQUIRE(boxes.get(i).upperCorner == unpacked[i].upperCorner);
+	}
+	REQUIRE(CollisionDetection::overlapMask(unpacked[59], boxes, 56) == CollisionDetection::overlapMaskScalar(unpacked[59], boxes, 56));
+}
+
+TEST_CASE("The static BVH answers segment, ray and box queries like checking every box", "[collision]") {
+	std::srand(3);
+	//a map's worth of obstacles on a grid, every other one in a second layer
+	std::vector<BoundingBox> boxes;
+	StaticBvh bvh;
+	for (int i = 0; i < 400; i++) {
+		int col = std::rand() % 60, row = std::rand() % 60, width = 1 + std::rand() % 3;
+		boxes.push_back({{col - 0.5f, 0, row - 0.5f}, {col + width - 0.5f, 0, row + 0.5f}});
+		bvh.insert(i, boxes.back(), i % 2 == 0 ? 1 : 2);
+	}
+	//buildings come and go
+	for (int i = 0; i < 400; i += 7) {
+		bvh.remove(i);
+	}
+	bvh.remove(1000); //never was there
+	REQUIRE(bvh.size() == 400 - 58);
+	auto present = [&](int i) {
+		return i % 7 != 0;
+	};
+
+	//checked the slow way, a segment hits a box if any point along it is in the box
+	auto firstHitOf = [&](glm::vec3 start, glm::vec3 end, unsigned layers) {
+		StaticBvh::Hit best = {StaticBvh::NO_ITEM, 2};
+		for (int i = 0; i < (int) boxes.size(); i++) {
+			if (!present(i) || !((i % 2 == 0 ? 1u : 2u) & layers)) {
+				continue;
+			}
+			for (int step = 0; step <= 1000 && float(step) / 1000 < best.t; step++) {
+				glm::vec3 point = start + (end - start) * (float(step) / 1000);
+				if (point.x >= boxes[i].lowerCorner.x && point.x <= boxes[i].upperCorner.x &&
+					point.z >= boxes[i].lowerCorner.z && point.z <= boxes[i].upperCorner.z) {
+					best = {i, float(step) / 1000};
+					break;
+				}
+			}
+		}
+		return best;
+	};
+
+	std::vector<CollisionDetection::LineSegment> shots;
+	for (int i = 0; i < 100; i++) {
+		shots.push_back({{randomCoordinate(60), 0, randomCoordinate(60)}, {randomCoordinate(60), 0, randomCoordinate(60)}});
+	}
+	std::vector<StaticBvh::Hit> hits, anyHits;
+	bvh.firstHits(shots, hits, 1);
+	bvh.firstHits(shots, anyHits, 1, true);
+	for (size_t i = 0; i < shots.size(); i++) {
+		StaticBvh::Hit expected = firstHitOf(shots[i].start, shots[i].end, 1);
+		if (expected.item == StaticBvh::NO_ITEM) {
+			REQUIRE(hits[i].item == StaticBvh::NO_ITEM);
+		} else {
+			REQUIRE(hits[i].item != StaticBvh::NO_ITEM);
+			REQUIRE(hits[i].item % 2 == 0);
+			REQUIRE(hits[i].t <= expected.t);
+			REQUIRE(hits[i].t > expected.t - 0.002f); //the slow way steps along the segment
+		}
+		REQUIRE((anyHits[i].item != StaticBvh::NO_ITEM) == (expected.item != StaticBvh::NO_ITEM));
+		REQUIRE(bvh.anyHit(shots[i], 1) == (expected.item != StaticBvh::NO_ITEM));
+		REQUIRE(bvh.firstHit(shots[i], 1).item == hits[i].item);
+	}
+
+	//a ray is a segment that doesn't stop, t counts lengths of direction
+	StaticBvh::Hit ray = bvh.firstHit(glm::vec3(-10, 0, 30), glm::vec3(1, 0, 0));
+	StaticBvh::Hit segment = bvh.firstHit({{-10, 0, 30}, {90, 0, 30}});
+	REQUIRE(ray.item == segment.item);
+	if (ray.item != StaticBvh::NO_ITEM) {
+		REQUIRE(ray.t == Approx(segment.t * 100));
+	}
+	REQUIRE(bvh.firstHit(glm::vec3(-10, 0, 30), glm::vec3(-1, 0, 0)).item == StaticBvh::NO_ITEM);
+
+	//box queries want a real overlap, boxes just touching an edge don't count
+	for (int test = 0; test < 100; test++) {
+		int col = std::rand() % 60, row = std::rand() % 60;
+		BoundingBox area = {{col - 0.5f, 0, row - 0.5f}, {col + 1.5f, 0, row + 1.5f}};
+		std::vector<int> found;
+		bvh.overlapping(area, found);
+		std::sort(found.begin(), found.end());
+		std::vector<int> expected;
+		for (int i = 0; i < (int) boxes.size(); i++) {
+			if (present(i) && CollisionDetection::aabbsOverlap(area, boxes[i])) {
+				expected.push_back(i);
+			}
+		}
+		REQUIRE(found == expected);
+	}
+}
@@ -4,6 +4,8 @@
 
 //#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
 #include "catch.hpp"
+#include "navgrid.hpp"
+#include "pathrequests.hpp"
 #include "unitcomp.hpp"
 #include "world.hpp"
 #include "global.hpp"
@@ -32,4 +34,72 @@ TEST_CASE("Unit range is accurate", "[generic_unit]") {
 	REQUIRE(!genericUnit1->canSee(genericUnit2));
 	REQUIRE(!genericUnit1->inAttackRange(genericUnit2));
 
-}
\ No newline at end of file
+}
+
+namespace {
+	// an open level, the same every time
+	void loadOpenLevel() {
+		AI::NavGrid::init(std::vector<std::vector<int>>(12, std::vector<int>(12, Config::DEFAULT_TRAVERSABLE_COST)));
+	}
+
+	// one game tick for units, in the order UnitManager runs it
+	void tick(const std::vector<std::shared_ptr<Entity>>& units, double elapsed_ms) {
+		AI::pathRequests::update();
+		Model::collisionDetector.beginCollisions(elapsed_ms);
+		for (auto& unit : units) {
+			unit->computeNextMoveLocation(elapsed_ms);
+		}
+		Model::collisionDetector.finishCollisions();
+		for (auto& unit : units) {
+			unit->move(elapsed_ms);
+		}
+	}
+}
+
+TEST_CASE("Units that bounce off something keep searching the way their order asked", "[generic_unit]") {
+	loadOpenLevel();
+	std::shared_ptr<Entity> walker = std::make_shared<Entity>();
+	std::shared_ptr<Entity> blocker = std::make_shared<Entity>();
+	walker->setPosition(0, {1, 0, 2});
+	blocker->setPosition(0, {6, 0, 2});
+
+	AI::aStar::PathOptions scouting{AI::aStar::SearchMode::WEIGHTED, 1, true, true};
+	walker->moveToWithPathOptions(UnitState::MOVE, {10, 0, 2}, scouting);
+	for (int ticks = 0; ticks < 200 && walker->collisionCooldown <= 0; ticks++) {
+		tick({walker, blocker}, 16);
+	}
+	REQUIRE(walker->collisionCooldown > 0);
+
+	//the detour around the blocker and the rest of the order
+	REQUIRE(walker->destinations.size() == 2);
+	for (const Destination& destination : walker->destinations) {
+		REQUIRE(destination.pathOptions.mode == AI::aStar::SearchMode::WEIGHTED);
+		REQUIRE(destination.pathOptions.smooth);
+		REQUIRE(destination.pathOptions.cache);
+	}
+	REQUIRE(walker->destinations.back().position == glm::vec3(10, 0, 2));
+
+	walker->softDelete();
+	blocker->softDelete();
+}
+
+TEST_CASE("Fast units stop where they would hit something instead of where the tick left them", "[generic_unit]") {
+	loadOpenLevel();
+	std::shared_ptr<Entity> walker = std::make_shared<Entity>();
+	std::shared_ptr<Entity> blocker = std::make_shared<Entity>();
+	walker->setPosition(0, {1, 0, 2});
+	blocker->setPosition(0, {6, 0, 2});
+	walker->rigidBody.setContinuous(true);
+
+	//at 10 cells a second a quarter second tick covers 2.5 cells, more than the blocker is wide
+	walker->moveToWithPathOptions(UnitState::MOVE, {11, 0, 2}, {});
+	for (int ticks = 0; ticks < 50 && walker->collisionCooldown <= 0; ticks++) {
+		tick({walker, blocker}, 250);
+	}
+	REQUIRE(walker->collisionCooldown > 0);
+	REQUIRE(walker->getPosition().x == Approx(5)); //right up against the blocker
+	REQUIRE(walker->getPosition().z == Approx(2));
+
+	walker->softDelete();
+	blocker->softDelete();
+}
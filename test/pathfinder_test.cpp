@@ -0,0 +1,868 @@
+#include <algorithm>
+#include <limits>
+#include <set>
+#include "catch.hpp"
+#include "cooperative.hpp"
+#include "dstarlite.hpp"
+#include "flowfield.hpp"
+#include "hierarchicalpathfinder.hpp"
+#include "landmarks.hpp"
+#include "pathcache.hpp"
+#include "pathfinder.hpp"
+#include "pathindex.hpp"
+#include "pathrequests.hpp"
+#include "regions.hpp"
+#include "global.hpp"
+
+namespace {
+	// builds the nav grid from a picture of the level, '#' is an obstacle and anything else is open
+	void loadCostMap(const std::vector<std::string>& rows) {
+		Global::levelTraversalCostMap.clear();
+		for (const auto& row : rows) {
+			std::vector<int> costs;
+			for (char cell : row) {
+				costs.push_back(cell == '#' ? Config::OBSTACLE_COST : Config::DEFAULT_TRAVERSABLE_COST);
+			}
+			Global::levelTraversalCostMap.push_back(costs);
+		}
+		Global::levelHeight = rows.size();
+		Global::levelWidth = rows.front().size();
+		Global::levelWithUnitsTraversalCostMap = Global::levelTraversalCostMap;
+		AI::NavGrid::init(Global::levelTraversalCostMap);
+	}
+}
+
+TEST_CASE("A* finds a path around a wall", "[pathfinder]") {
+	loadCostMap({
+			"     ",
+			" ### ",
+			"   # ",
+			"   # ",
+			"     ",
+	});
+
+	auto result = AI::aStar::findPath({0, 0, 2}, {4, 0, 2});
+	REQUIRE(result.first);
+	REQUIRE(result.second.front() == glm::vec3(0, 0, 2));
+	REQUIRE(result.second.back() == glm::vec3(4, 0, 2));
+	for (const auto& waypoint : result.second) {
+		REQUIRE(Global::levelTraversalCostMap[(int) waypoint.z][(int) waypoint.x] < Config::OBSTACLE_COST);
+	}
+
+	//searching again reuses the workspace and has to give the same answer
+	auto again = AI::aStar::findPath({0, 0, 2}, {4, 0, 2});
+	REQUIRE(again.second == result.second);
+}
+
+TEST_CASE("A* does not cut corners and rejects walled off goals", "[pathfinder]") {
+	loadCostMap({
+			" # ",
+			"#  ",
+			"   ",
+	});
+	//the only diagonal out of the corner squeezes between two obstacles
+	REQUIRE(!AI::aStar::findPath({0, 0, 0}, {2, 0, 2}).first);
+
+	loadCostMap({
+			"     ",
+			"  #  ",
+			" # # ",
+			"  #  ",
+	});
+	REQUIRE(!AI::aStar::findPath({0, 0, 0}, {2, 0, 2}).first);
+	REQUIRE(!AI::aStar::findPath({0, 0, 0}, {20, 0, 2}).first);
+}
+
+TEST_CASE("Jump point search matches A* and sees placed buildings", "[pathfinder]") {
+	loadCostMap({
+			"                                                                    ",
+			"  ####################################################  ##########  ",
+			"                                                     #  #           ",
+			" ###### ############################################ #  # ########  ",
+			"      #                                            # #    #         ",
+			"      ############################################## ######         ",
+			"                                                                    ",
+	});
+	AI::aStar::PathOptions jumpPoint{AI::aStar::SearchMode::JUMP_POINT};
+	glm::vec3 start(0, 0, 6), goal(66, 0, 4);
+
+	//jump points get expanded back into single cell steps, so both paths can be costed the same way
+	auto pathCost = [](const std::vector<glm::vec3>& path) {
+		int cost = 0;
+		for (size_t i = 2; i + 1 < path.size(); i++) {
+			glm::vec3 step = path[i] - path[i - 1];
+			REQUIRE(std::abs(step.x) <= 1);
+			REQUIRE(std::abs(step.z) <= 1);
+			cost += step.x != 0 && step.z != 0 ? AI::aStar::DIAGONAL_MOVEMENT_COST : AI::aStar::STRAIGHT_MOVEMENT_COST;
+		}
+		return cost;
+	};
+
+	auto aStarPath = AI::aStar::findPath(start, goal);
+	auto jumpPointPath = AI::aStar::findPath(start, goal, jumpPoint);
+	REQUIRE(aStarPath.first);
+	REQUIRE(jumpPointPath.first);
+	REQUIRE(pathCost(jumpPointPath.second) == pathCost(aStarPath.second));
+
+	//wall off the goal the same way Level::placeTile does, the obstacle bitsets have to follow
+	for (int row = 0; row < Global::levelHeight; row++) {
+		Global::levelTraversalCostMap[row][60] = Config::OBSTACLE_COST;
+	}
+	AI::NavGrid::updateArea(60, 0, 60, Global::levelHeight - 1);
+	REQUIRE(!AI::aStar::findPath(start, goal, jumpPoint).first);
+}
+
+TEST_CASE("Hierarchical paths follow buildings placed after the level loaded", "[pathfinder]") {
+	std::vector<std::string> rows(8, std::string(64, ' '));
+	for (int row = 0; row < 7; row++) {
+		rows[row][40] = '#'; //a wall with a gap at the bottom, three clusters away from the start
+	}
+	loadCostMap(rows);
+	AI::aStar::PathOptions hierarchical{AI::aStar::SearchMode::HIERARCHICAL};
+	glm::vec3 start(0, 0, 0), goal(63, 0, 0);
+
+	auto path = AI::aStar::findPath(start, goal, hierarchical);
+	REQUIRE(path.first);
+	for (size_t i = 2; i + 1 < path.second.size(); i++) {
+		glm::vec3 step = path.second[i] - path.second[i - 1];
+		REQUIRE(std::abs(step.x) <= 1);
+		REQUIRE(std::abs(step.z) <= 1);
+		REQUIRE(Global::levelTraversalCostMap[(int) path.second[i].z][(int) path.second[i].x] < Config::OBSTACLE_COST);
+	}
+
+	//plug the gap, only the clusters next to it get rebuilt
+	Global::levelTraversalCostMap[7][40] = Config::OBSTACLE_COST;
+	AI::NavGrid::updateArea(40, 7, 40, 7);
+	REQUIRE(!AI::aStar::findPath(start, goal, hierarchical).first);
+}
+
+TEST_CASE("Incremental plans repair around buildings placed on the way", "[pathfinder]") {
+	loadCostMap({
+			"                                        ",
+			"                    #                   ",
+			"                    #                   ",
+			"                    #                   ",
+			"                    #                   ",
+			"                    #                   ",
+			"                    #                   ",
+			"                    #                   ",
+			"                    #                   ",
+			"                    #                   ",
+			"                                        ",
+	});
+	const AI::NavGrid::Grid& grid = AI::NavGrid::grid;
+	int goalCell = grid.index(39, 5);
+
+	auto cellsCost = [&](const std::vector<int>& cells) {
+		int cost = 0;
+		for (size_t i = 1; i < cells.size(); i++) {
+			int dCol = std::abs(grid.colOf(cells[i]) - grid.colOf(cells[i - 1]));
+			int dRow = std::abs(grid.rowOf(cells[i]) - grid.rowOf(cells[i - 1]));
+			REQUIRE(dCol <= 1);
+			REQUIRE(dRow <= 1);
+			REQUIRE(!grid.isObstacle(cells[i]));
+			cost += dCol != 0 && dRow != 0 ? AI::aStar::DIAGONAL_MOVEMENT_COST : AI::aStar::STRAIGHT_MOVEMENT_COST;
+		}
+		return cost;
+	};
+	auto aStarCost = [&](int startCell) {
+		auto path = AI::aStar::findPath(glm::vec3(grid.colOf(startCell), 0, grid.rowOf(startCell)),
+										glm::vec3(grid.colOf(goalCell), 0, grid.rowOf(goalCell)));
+		REQUIRE(path.first);
+		std::vector<int> cells(1, startCell);
+		for (size_t i = 1; i + 1 < path.second.size(); i++) { //the last waypoint is the goal position on the goal cell
+			cells.push_back(grid.index((int) path.second[i].x, (int) path.second[i].z));
+		}
+		return cellsCost(cells);
+	};
+
+	AI::dStarLite::Planner planner;
+	std::vector<int> cells;
+	REQUIRE(planner.plan(grid, grid.index(0, 5), goalCell, cells));
+	REQUIRE(cells.front() == grid.index(0, 5));
+	REQUIRE(cells.back() == goalCell);
+	REQUIRE(cellsCost(cells) == aStarCost(grid.index(0, 5)));
+	REQUIRE(planner.isUpToDate(grid));
+
+	//walk a bit, then a building goes up in the top gap
+	int walkedTo = cells[4];
+	for (int col = 19; col <= 21; col++) {
+		Global::levelTraversalCostMap[0][col] = Config::OBSTACLE_COST;
+	}
+	AI::NavGrid::updateArea(19, 0, 21, 0);
+	REQUIRE(!planner.isUpToDate(grid));
+
+	REQUIRE(planner.plan(grid, walkedTo, goalCell, cells));
+	int repairExpansions = planner.lastExpansions();
+	REQUIRE(cells.front() == walkedTo);
+	REQUIRE(cellsCost(cells) == aStarCost(walkedTo));
+
+	AI::dStarLite::Planner fresh;
+	std::vector<int> freshCells;
+	REQUIRE(fresh.plan(grid, walkedTo, goalCell, freshCells));
+	REQUIRE(cellsCost(freshCells) == cellsCost(cells));
+	REQUIRE(repairExpansions < fresh.lastExpansions());
+
+	//close the other gap too
+	for (int col = 19; col <= 21; col++) {
+		Global::levelTraversalCostMap[10][col] = Config::OBSTACLE_COST;
+	}
+	AI::NavGrid::updateArea(19, 10, 21, 10);
+	REQUIRE(!planner.plan(grid, walkedTo, goalCell, cells));
+	REQUIRE(cells.empty());
+}
+
+TEST_CASE("D* Lite walks up to buildings and off obstacles like A* does", "[pathfinder]") {
+	loadCostMap({
+			"          ",
+			"   ###    ",
+			"   ###  # ",
+			"   ###  # ",
+			"        # ",
+	});
+	const AI::NavGrid::Grid& grid = AI::NavGrid::grid;
+	auto plannedCost = [&](int start, int goal) {
+		AI::dStarLite::Planner planner;
+		std::vector<int> cells;
+		REQUIRE(planner.plan(grid, start, goal, cells));
+		REQUIRE(cells.front() == start);
+		REQUIRE(cells.back() == goal);
+		int cost = 0;
+		for (size_t i = 1; i < cells.size(); i++) {
+			bool diagonal = grid.colOf(cells[i]) != grid.colOf(cells[i - 1]) && grid.rowOf(cells[i]) != grid.rowOf(cells[i - 1]);
+			REQUIRE((i + 1 == cells.size() || !grid.isObstacle(cells[i]))); //only the goal can be in the building
+			cost += diagonal ? AI::aStar::DIAGONAL_MOVEMENT_COST : AI::aStar::STRAIGHT_MOVEMENT_COST;
+		}
+		return cost;
+	};
+
+	//the building is the goal, its nearest cell counts as open
+	REQUIRE(plannedCost(grid.index(0, 2), grid.index(3, 2)) == 3 * AI::aStar::STRAIGHT_MOVEMENT_COST);
+	REQUIRE(plannedCost(grid.index(2, 0), grid.index(3, 1)) == AI::aStar::DIAGONAL_MOVEMENT_COST);
+
+	//a unit that ended up on the wall can still step off it
+	REQUIRE(plannedCost(grid.index(8, 3), grid.index(9, 3)) == AI::aStar::STRAIGHT_MOVEMENT_COST);
+}
+
+TEST_CASE("Goals in walled off pockets are rejected without a search", "[pathfinder]") {
+	loadCostMap({
+			"                                        ",
+			"                        #####           ",
+			"                        #   #           ",
+			"                        #   #   ####    ",
+			"                        #####   ####    ",
+			"                                ####    ",
+			"                                        ",
+	});
+	const AI::NavGrid::Grid& grid = AI::NavGrid::grid;
+	int start = grid.index(0, 0);
+	int pocket = grid.index(26, 2);
+	int lake = grid.index(34, 4);
+
+	REQUIRE(!AI::regions::canReach(grid, start, pocket));
+	REQUIRE(!AI::aStar::findPath(glm::vec3(0, 0, 0), glm::vec3(26, 0, 2)).first);
+	//the edges of buildings can still be walked up to, the middle of one can't
+	REQUIRE(AI::regions::canReach(grid, start, grid.index(32, 4)));
+	REQUIRE(AI::regions::canReach(grid, start, grid.index(24, 2)));
+	REQUIRE(!AI::regions::canReach(grid, start, lake));
+
+	//redirects go to the closest cell outside, the middle of the lake has open cells two steps away
+	int nearest = AI::regions::nearestReachableCell(grid, start, lake);
+	REQUIRE(nearest >= 0);
+	REQUIRE(!grid.isObstacle(nearest));
+	REQUIRE(AI::regions::canReach(grid, start, nearest));
+	REQUIRE(std::abs(grid.colOf(nearest) - 34) + std::abs(grid.rowOf(nearest) - 4) == 2);
+
+	//knock a hole in the wall and the pocket joins up, close it and it's cut off again
+	Global::levelTraversalCostMap[4][26] = Config::DEFAULT_TRAVERSABLE_COST;
+	AI::NavGrid::updateArea(26, 4, 26, 4);
+	REQUIRE(AI::regions::canReach(grid, start, pocket));
+	REQUIRE(AI::aStar::findPath(glm::vec3(0, 0, 0), glm::vec3(26, 0, 2)).first);
+	Global::levelTraversalCostMap[4][26] = Config::OBSTACLE_COST;
+	AI::NavGrid::updateArea(26, 4, 26, 4);
+	REQUIRE(!AI::regions::canReach(grid, start, pocket));
+}
+
+TEST_CASE("Landmark estimates keep A* optimal while buildings come and go", "[pathfinder]") {
+	loadCostMap({
+			"        #         #         #         ",
+			" ###### # ####### # ####### # ###### #",
+			" #    # #       # #       # #      # #",
+			" # ## # ####### # ####### # ###### # #",
+			" #  #         # #       # #        # #",
+			" ## ######### # ####### # ######## # #",
+			"            #                    #    ",
+	});
+	const AI::NavGrid::Grid& grid = AI::NavGrid::grid;
+	AI::landmarks::Landmarks& landmarks = AI::landmarks::landmarks;
+	REQUIRE(landmarks.landmarkCount() == AI::landmarks::DEFAULT_LANDMARK_COUNT);
+	REQUIRE(landmarks.memoryUsage() >= sizeof(int) * 2 * grid.cellCount() * landmarks.landmarkCount());
+
+	AI::aStar::SearchWorkspace workspace;
+	auto costs = [&](int startCell, int goalCell) {
+		bool found = AI::aStar::search(grid, startCell, goalCell, workspace);
+		int plain = found ? workspace.gScore(goalCell) : -1;
+		found = AI::aStar::search(grid, startCell, goalCell, workspace, &landmarks);
+		return std::make_pair(plain, found ? workspace.gScore(goalCell) : -1);
+	};
+	auto checkAll = [&]() {
+		for (int start = 0; start < grid.cellCount(); start += 7) {
+			for (int goal = 3; goal < grid.cellCount(); goal += 11) {
+				if (!grid.isObstacle(start)) {
+					auto cost = costs(start, goal);
+					REQUIRE(cost.first == cost.second);
+				}
+			}
+		}
+	};
+	checkAll();
+
+	//a building only makes things more expensive, the old tables are still used until they are rebuilt
+	Global::levelTraversalCostMap[6][20] = Config::OBSTACLE_COST;
+	AI::NavGrid::updateArea(20, 6, 20, 6);
+	REQUIRE(landmarks.staleCount(grid) == landmarks.landmarkCount());
+	checkAll();
+
+	//taking it away again can open a shortcut the tables don't know about
+	Global::levelTraversalCostMap[6][20] = Config::DEFAULT_TRAVERSABLE_COST;
+	Global::levelTraversalCostMap[5][1] = Config::DEFAULT_TRAVERSABLE_COST;
+	AI::NavGrid::updateArea(1, 5, 20, 6);
+	checkAll();
+
+	landmarks.repair(grid, true);
+	REQUIRE(landmarks.staleCount(grid) == 0);
+	checkAll();
+}
+
+TEST_CASE("Only entities with a changed cell on their path are told to repath", "[pathfinder]") {
+	loadCostMap(std::vector<std::string>(20, std::string(40, ' ')));
+	AI::pathIndex::clear();
+	std::vector<Entity*> affected;
+	AI::pathIndex::takeAffected(AI::NavGrid::grid, affected); //catch up with the new level
+
+	//the index never looks inside the entities, any distinct addresses do
+	char units[3];
+	Entity* crossing = reinterpret_cast<Entity*>(&units[0]);
+	Entity* besideIt = reinterpret_cast<Entity*>(&units[1]);
+	Entity* finished = reinterpret_cast<Entity*>(&units[2]);
+	auto straightPath = [](int row) {
+		std::vector<glm::vec3> path;
+		for (int col = 0; col < 40; col++) {
+			path.emplace_back(col, 0, row);
+		}
+		return path;
+	};
+	AI::pathIndex::add(crossing, straightPath(5));
+	AI::pathIndex::add(besideIt, straightPath(7)); //same blocks, but never steps on or next to the building
+	AI::pathIndex::add(finished, straightPath(5));
+	AI::pathIndex::remove(finished);
+	REQUIRE(AI::pathIndex::indexedCount() == 2);
+
+	for (int col = 20; col <= 22; col++) {
+		Global::levelTraversalCostMap[5][col] = Config::OBSTACLE_COST;
+	}
+	AI::NavGrid::updateArea(20, 5, 22, 5);
+	AI::pathIndex::takeAffected(AI::NavGrid::grid, affected);
+	REQUIRE(affected == std::vector<Entity*>{crossing});
+
+	//nothing changed since, nobody else gets told
+	AI::pathIndex::takeAffected(AI::NavGrid::grid, affected);
+	REQUIRE(affected.empty());
+
+	//a new path replaces the old one in the index
+	AI::pathIndex::add(crossing, straightPath(15));
+	Global::levelTraversalCostMap[5][10] = Config::OBSTACLE_COST;
+	AI::NavGrid::updateArea(10, 5, 10, 5);
+	AI::pathIndex::takeAffected(AI::NavGrid::grid, affected);
+	REQUIRE(affected.empty());
+
+	//a building on the corner of a diagonal step blocks it without being on the path, even from the next block over
+	AI::pathIndex::add(crossing, {{6, 0, 14}, {7, 0, 15}, {8, 0, 16}});
+	Global::levelTraversalCostMap[15][8] = Config::OBSTACLE_COST;
+	AI::NavGrid::updateArea(8, 15, 8, 15);
+	AI::pathIndex::takeAffected(AI::NavGrid::grid, affected);
+	REQUIRE(affected == std::vector<Entity*>{crossing});
+	AI::pathIndex::clear();
+}
+
+TEST_CASE("Wide agents only path where they fit and see buildings placed later", "[pathfinder]") {
+	loadCostMap({
+			"              ",
+			"              ",
+			"###### ###  ##",
+			"              ",
+			"              ",
+	});
+	const AI::NavGrid::Grid& grid = AI::NavGrid::grid;
+	AI::aStar::PathOptions wide;
+	wide.agentSize = 2;
+	auto fits = [&](const std::vector<glm::vec3>& path) {
+		for (const glm::vec3& waypoint : path) {
+			for (int row = int(waypoint.z); row < int(waypoint.z) + 2; row++) {
+				for (int col = int(waypoint.x); col < int(waypoint.x) + 2; col++) {
+					if (!grid.withinBounds(col, row) || grid.isObstacle(grid.index(col, row))) {
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	};
+
+	//the one cell gap right above the goal is fine for a single cell, a 2x2 agent has to use the wider one
+	auto narrow = AI::aStar::findPath({6, 0, 0}, {6, 0, 3});
+	REQUIRE(narrow.first);
+	REQUIRE(narrow.second.size() == 5);
+	for (auto mode : {AI::aStar::SearchMode::ASTAR, AI::aStar::SearchMode::JUMP_POINT, AI::aStar::SearchMode::HIERARCHICAL}) {
+		wide.mode = mode;
+		auto result = AI::aStar::findPath({6, 0, 0}, {6, 0, 3}, wide);
+		REQUIRE(result.first);
+		REQUIRE(result.second.size() > 5);
+		REQUIRE(fits(result.second));
+	}
+
+	//fill half the wide gap in and only single cells get thru
+	AI::NavGrid::agentGrid(2);
+	Global::levelTraversalCostMap[2][11] = Config::OBSTACLE_COST;
+	AI::NavGrid::updateArea(11, 2, 11, 2);
+	REQUIRE(!AI::aStar::findPath({6, 0, 0}, {6, 0, 3}, wide).first);
+	REQUIRE(AI::aStar::findPath({10, 0, 0}, {10, 0, 3}).first);
+
+	//patched in place, the same as building everything again
+	std::vector<uint8_t> clearance = grid.clearance;
+	std::vector<int> wideCosts = AI::NavGrid::agentGrid(2).costs;
+	AI::NavGrid::init(Global::levelTraversalCostMap);
+	REQUIRE(grid.clearance == clearance);
+	REQUIRE(AI::NavGrid::agentGrid(2).costs == wideCosts);
+}
+
+TEST_CASE("Smoothed paths keep only their corners and never walk thru walls", "[pathfinder]") {
+	loadCostMap({
+			"                    ",
+			"                    ",
+			"       #            ",
+			"       #            ",
+			"       #######      ",
+			"                    ",
+			"                    ",
+	});
+	const AI::NavGrid::Grid& grid = AI::NavGrid::grid;
+	AI::aStar::PathOptions options;
+	options.smooth = true;
+	auto cellOf = [&](const glm::vec3& waypoint) {
+		return grid.index(int(waypoint.x + 0.5), int(waypoint.z + 0.5));
+	};
+
+	//nothing in the way, straight from the start to the goal
+	auto open = AI::aStar::findPath({0, 0, 0}, {19, 0, 1}, options);
+	REQUIRE(open.first);
+	REQUIRE(open.second == std::vector<glm::vec3>{{0, 0, 0}, {19, 0, 1}});
+
+	for (auto mode : {AI::aStar::SearchMode::ASTAR, AI::aStar::SearchMode::JUMP_POINT, AI::aStar::SearchMode::HIERARCHICAL}) {
+		options.mode = mode;
+		auto around = AI::aStar::findPath({4, 0, 5}, {10, 0, 3}, options);
+		auto cells = AI::aStar::findPath({4, 0, 5}, {10, 0, 3});
+		REQUIRE(around.first);
+		REQUIRE(around.second.size() <= 4);
+		REQUIRE(around.second.size() < cells.second.size());
+		for (size_t i = 1; i < around.second.size(); i++) {
+			REQUIRE(AI::aStar::lineOfSight(grid, cellOf(around.second[i - 1]), cellOf(around.second[i]),
+										   Config::DEFAULT_TRAVERSABLE_COST, -1));
+		}
+	}
+
+	//lines thru a corner need both cells beside it, the same as diagonal steps
+	REQUIRE(!AI::aStar::lineOfSight(grid, grid.index(6, 4), grid.index(8, 2), Config::DEFAULT_TRAVERSABLE_COST, -1));
+	REQUIRE(AI::aStar::lineOfSight(grid, grid.index(6, 5), grid.index(8, 5), Config::DEFAULT_TRAVERSABLE_COST, -1));
+
+	//the path index still sees the cells between the corners
+	char unit;
+	Entity* entity = reinterpret_cast<Entity*>(&unit);
+	std::vector<Entity*> affected;
+	AI::pathIndex::clear();
+	AI::pathIndex::add(entity, open.second);
+	AI::pathIndex::takeAffected(grid, affected);
+	Global::levelTraversalCostMap[0][5] = Config::OBSTACLE_COST;
+	AI::NavGrid::updateArea(5, 0, 5, 0);
+	AI::pathIndex::takeAffected(grid, affected);
+	REQUIRE(affected == std::vector<Entity*>{entity});
+	AI::pathIndex::clear();
+}
+
+TEST_CASE("Cached paths are reused between the same parts of the level until something is built on them", "[pathfinder]") {
+	loadCostMap({std::vector<std::string>(8, std::string(64, ' '))});
+	AI::pathCache::clear();
+	AI::aStar::PathOptions options{AI::aStar::SearchMode::JUMP_POINT};
+	options.cache = true;
+	auto walkable = [](const std::vector<glm::vec3>& path) {
+		for (size_t i = 1; i < path.size(); i++) {
+			glm::vec3 step = path[i] - path[i - 1];
+			REQUIRE(std::abs(step.x) <= 1);
+			REQUIRE(std::abs(step.z) <= 1);
+			REQUIRE(Global::levelTraversalCostMap[(int) path[i].z][(int) path[i].x] < Config::OBSTACLE_COST);
+		}
+	};
+
+	REQUIRE(AI::aStar::findPath({1, 0, 3}, {62, 0, 3}, options).first);
+	REQUIRE(AI::pathCache::stats().misses == 1);
+	REQUIRE(AI::pathCache::size() == 1);
+
+	//other cells in the same two blocks reuse the corridor and only search their ends
+	auto reused = AI::aStar::findPath({2, 0, 5}, {60, 0, 1}, options);
+	REQUIRE(reused.first);
+	REQUIRE(reused.second.front() == glm::vec3(2, 0, 5));
+	REQUIRE(reused.second.back() == glm::vec3(60, 0, 1));
+	walkable(reused.second);
+	REQUIRE(AI::pathCache::stats().hits == 1);
+
+	//a building away from the corridor doesn't drop it
+	Global::levelTraversalCostMap[0][30] = Config::OBSTACLE_COST;
+	AI::NavGrid::updateArea(30, 0, 30, 0);
+	REQUIRE(AI::aStar::findPath({2, 0, 5}, {60, 0, 1}, options).first);
+	REQUIRE(AI::pathCache::stats().hits == 2);
+
+	//a wall across it does, and the new path goes round thru the gap
+	for (int row = 0; row < 7; row++) {
+		Global::levelTraversalCostMap[row][30] = Config::OBSTACLE_COST;
+	}
+	AI::NavGrid::updateArea(30, 0, 30, 6);
+	auto around = AI::aStar::findPath({2, 0, 5}, {60, 0, 1}, options);
+	REQUIRE(around.first);
+	walkable(around.second);
+	AI::pathCache::Stats stats = AI::pathCache::stats();
+	REQUIRE(stats.invalidated == 1);
+	REQUIRE(stats.misses == 2);
+	REQUIRE(stats.hitRate() == Approx(0.5));
+	AI::pathCache::clear();
+}
+
+TEST_CASE("Cooperative plans never put two units in the same cell at the same step", "[pathfinder]") {
+	loadCostMap({
+			"          ",
+			"          ",
+			"#### #####",
+			"          ",
+			"          ",
+	});
+	const AI::NavGrid::Grid& grid = AI::NavGrid::grid;
+	AI::cooperative::ReservationTable table;
+	char units[3];
+	//the cells a plan holds at each step, the same way the table reserves them
+	auto occupied = [](int startCell, int startStep, const std::vector<AI::cooperative::Arrival>& arrivals) {
+		std::set<std::pair<int, int>> cells;
+		int cell = startCell, from = startStep;
+		for (const AI::cooperative::Arrival& arrival : arrivals) {
+			for (int step = from; step <= arrival.step; step++) {
+				cells.emplace(cell, step);
+				if (step > from) {
+					cells.emplace(arrival.cell, step);
+				}
+			}
+			cell = arrival.cell;
+			from = arrival.step;
+		}
+		cells.emplace(cell, from);
+		return cells;
+	};
+	auto planFor = [&](void* unit, int startCol, int startRow, int goalCol, int goalRow,
+					   std::vector<AI::cooperative::Arrival>& arrivals) {
+		int start = grid.index(startCol, startRow);
+		REQUIRE(AI::cooperative::plan(grid, table, AI::landmarks::landmarks, start, table.currentStep(),
+									  grid.index(goalCol, goalRow), 10, unit, arrivals));
+		table.reservePlan(start, table.currentStep(), arrivals, unit);
+		return occupied(start, table.currentStep(), arrivals);
+	};
+
+	//two units heading thru the gap at the same time and one coming the other way
+	std::vector<AI::cooperative::Arrival> first, second, oncoming;
+	auto firstCells = planFor(&units[0], 3, 1, 5, 3, first);
+	auto secondCells = planFor(&units[1], 5, 1, 3, 3, second);
+	auto oncomingCells = planFor(&units[2], 4, 4, 4, 0, oncoming);
+	REQUIRE(first.back().cell == grid.index(5, 3));
+	REQUIRE(second.back().cell == grid.index(3, 3));
+	REQUIRE(oncoming.back().cell == grid.index(4, 0));
+	for (const auto& cell : firstCells) {
+		REQUIRE(secondCells.count(cell) == 0);
+		REQUIRE(oncomingCells.count(cell) == 0);
+	}
+	for (const auto& cell : secondCells) {
+		REQUIRE(oncomingCells.count(cell) == 0);
+	}
+	REQUIRE(second.back().step > first.back().step); //had to let the first one thru
+
+	//released reservations are gone right away, the rest once the clock passes them
+	int held = table.reservationCount();
+	table.release(&units[2]);
+	REQUIRE(table.reservationCount() < held);
+	table.advance(AI::cooperative::STEP_MS * (AI::cooperative::WINDOW_STEPS * 3));
+	REQUIRE(table.reservationCount() == 0);
+}
+
+TEST_CASE("Flow fields are shared and lead every open cell into the goal area", "[pathfinder]") {
+	loadCostMap({
+			"        ",
+			" ###### ",
+			" #    # ",
+			" # ## # ",
+			"   ##   ",
+	});
+	const AI::NavGrid::Grid& grid = AI::NavGrid::grid;
+	std::vector<int> goalCells = {grid.index(3, 2), grid.index(4, 2)};
+
+	auto field = AI::flowField::getField(goalCells);
+	REQUIRE(AI::flowField::getField({goalCells[1], goalCells[0]}) == field);
+
+	for (int cell = 0; cell < grid.cellCount(); cell++) {
+		if (grid.isObstacle(cell)) {
+			REQUIRE(!field->reaches(cell));
+			continue;
+		}
+		//walking the directions has to cost exactly what the integration field says
+		REQUIRE(field->reaches(cell));
+		int current = cell, cost = 0;
+		while (!field->isGoal(current)) {
+			int next = field->nextCell(current);
+			bool diagonal = grid.colOf(next) != grid.colOf(current) && grid.rowOf(next) != grid.rowOf(current);
+			cost += diagonal ? AI::aStar::DIAGONAL_MOVEMENT_COST : AI::aStar::STRAIGHT_MOVEMENT_COST;
+			current = next;
+		}
+		REQUIRE(cost == field->integration[cell]);
+	}
+
+	//a building going up makes the field stale, refreshing rebuilds it once for everyone
+	Global::levelTraversalCostMap[4][2] = Config::OBSTACLE_COST;
+	AI::NavGrid::updateArea(2, 4, 2, 4);
+	auto refreshed = AI::flowField::refresh(field);
+	REQUIRE(refreshed != field);
+	REQUIRE(AI::flowField::refresh(field) == refreshed);
+	REQUIRE(refreshed->integration[grid.index(0, 4)] > field->integration[grid.index(0, 4)]); //has to go round to the other door
+}
+
+TEST_CASE("Neighbour masks are patched where buildings go up and allow exactly the moves a search may make", "[pathfinder]") {
+	loadCostMap({
+			"          ",
+			" ##    #  ",
+			" #   #    ",
+			"    ##  # ",
+			"          ",
+			"  #     # ",
+	});
+	AI::NavGrid::agentGrid(2);
+
+	auto requireMasksMatch = [](const AI::NavGrid::Grid& grid) {
+		auto isOpen = [&](int col, int row) {
+			return grid.withinBounds(col, row) && !grid.isObstacle(grid.index(col, row));
+		};
+		for (int cell = 0; cell < grid.cellCount(); cell++) {
+			int col = grid.colOf(cell), row = grid.rowOf(cell);
+			for (int i = 0; i < 8; i++) {
+				int nextCol = col + AI::NavGrid::neighborDirections[i].first;
+				int nextRow = row + AI::NavGrid::neighborDirections[i].second;
+				bool open = isOpen(nextCol, nextRow) && (i < 4 || (isOpen(nextCol, row) && isOpen(col, nextRow)));
+				REQUIRE(grid.canStep(cell, i) == open);
+				if (open) {
+					REQUIRE(cell + grid.stepOffset(i) == grid.index(nextCol, nextRow));
+				}
+			}
+		}
+	};
+	requireMasksMatch(AI::NavGrid::grid);
+	requireMasksMatch(*AI::NavGrid::grid.forAgentSize(2));
+
+	//buildings going up and coming down only touch the masks around them
+	Global::levelTraversalCostMap[4][3] = Config::OBSTACLE_COST;
+	Global::levelTraversalCostMap[4][4] = Config::OBSTACLE_COST;
+	AI::NavGrid::updateArea(3, 4, 4, 4);
+	Global::levelTraversalCostMap[1][1] = Config::DEFAULT_TRAVERSABLE_COST;
+	AI::NavGrid::updateArea(1, 1, 1, 1);
+	requireMasksMatch(AI::NavGrid::grid);
+	requireMasksMatch(*AI::NavGrid::grid.forAgentSize(2));
+
+	//a goal inside a building is still somewhere to step onto, and a corner to go round
+	const AI::NavGrid::Grid& grid = AI::NavGrid::grid;
+	AI::aStar::NeighborBuffer neighbors;
+	AI::aStar::getNeighbors(grid, grid.index(2, 2), grid.index(2, 1), neighbors);
+	bool stepsOnGoal = false, goesRoundGoal = false;
+	for (const AI::aStar::Neighbor& next : neighbors) {
+		stepsOnGoal |= next.cell == grid.index(2, 1);
+		goesRoundGoal |= next.cell == grid.index(3, 1);
+	}
+	REQUIRE(stepsOnGoal);
+	REQUIRE(goesRoundGoal);
+	REQUIRE(AI::aStar::findPath({0, 0, 4}, {2, 0, 1}).first);
+}
+
+TEST_CASE("Bucket and heap frontiers find paths of the same cost", "[pathfinder]") {
+	//walls and rough ground so there are plenty of ties and detours
+	std::vector<std::string> rows(30, std::string(40, ' '));
+	loadCostMap(rows);
+	for (int row = 0; row < 30; row++) {
+		for (int col = 0; col < 40; col++) {
+			int cell = row * 40 + col;
+			Global::levelTraversalCostMap[row][col] = (cell * 7919) % 13 == 0 ? Config::OBSTACLE_COST : (cell * 31) % 4 * 3;
+		}
+	}
+	AI::NavGrid::init(Global::levelTraversalCostMap);
+	const AI::NavGrid::Grid& grid = AI::NavGrid::grid;
+
+	AI::aStar::BucketQueue queue;
+	queue.push(500, 1);
+	queue.push(3, 2);
+	queue.push(3, 3);
+	queue.push(1200, 4); //further than the buckets reach, they have to grow
+	int key;
+	REQUIRE(queue.pop(key) == 3);
+	REQUIRE(key == 3);
+	REQUIRE(queue.pop(key) == 2);
+	REQUIRE(queue.pop(key) == 1);
+	REQUIRE(queue.pop(key) == 4);
+	REQUIRE(key == 1200);
+	REQUIRE(queue.empty());
+
+	AI::aStar::SearchWorkspace heapWorkspace, bucketWorkspace;
+	for (int start = 0; start < grid.cellCount(); start += 37) {
+		int goal = grid.cellCount() - 1 - start * 3 % grid.cellCount();
+		if (grid.isObstacle(start)) {
+			continue;
+		}
+		for (bool useLandmarks : {false, true}) {
+			const AI::landmarks::Landmarks* landmarks = useLandmarks ? &AI::landmarks::landmarks : nullptr;
+			AI::aStar::BasicResumableSearch<AI::aStar::HeapFrontier> heap(grid, start, goal, heapWorkspace, landmarks);
+			AI::aStar::BasicResumableSearch<AI::aStar::BucketFrontier> bucket(grid, start, goal, bucketWorkspace, landmarks);
+			auto found = heap.step(std::numeric_limits<int>::max());
+			REQUIRE((bucket.step(std::numeric_limits<int>::max()) == decltype(bucket)::Status::FOUND) ==
+					(found == decltype(heap)::Status::FOUND));
+			if (found == decltype(heap)::Status::FOUND) {
+				REQUIRE(bucketWorkspace.gScore(goal) == heapWorkspace.gScore(goal));
+			}
+		}
+	}
+}
+
+TEST_CASE("Weighted searches find a good enough path first and the best one when improved", "[pathfinder]") {
+	//a wall across the way with a lip on the near side, the way round the top is shorter
+	std::vector<std::string> rows(40, std::string(60, ' '));
+	for (int row = 3; row <= 37; row++) {
+		rows[row][30] = '#';
+	}
+	for (int col = 18; col <= 30; col++) {
+		rows[3][col] = '#';
+		rows[37][col] = '#';
+	}
+	for (int row = 30; row <= 37; row++) {
+		rows[row][18] = '#';
+	}
+	rows[3][18] = ' ';
+	loadCostMap(rows);
+	glm::vec3 start(5, 0, 20), goal(55, 0, 20);
+	auto cost = [](const std::vector<glm::vec3>& path) {
+		int total = 0;
+		for (size_t i = 1; i + 1 < path.size(); i++) { //the last waypoint is the goal position on the goal cell
+			bool diagonal = path[i].x != path[i - 1].x && path[i].z != path[i - 1].z;
+			total += diagonal ? AI::aStar::DIAGONAL_MOVEMENT_COST : AI::aStar::STRAIGHT_MOVEMENT_COST;
+		}
+		return total;
+	};
+	int best = cost(AI::aStar::findPath(start, goal).second);
+
+	AI::aStar::PathOptions options{AI::aStar::SearchMode::WEIGHTED};
+	options.weight = 3;
+	AI::aStar::SearchWorkspace workspace;
+	AI::aStar::PathSearch search(AI::NavGrid::grid, AI::hierarchical::graph, AI::landmarks::landmarks, start, goal, options,
+								 workspace);
+	REQUIRE(search.step(std::numeric_limits<int>::max()));
+	REQUIRE(search.result().first);
+	int first = cost(search.result().second);
+	REQUIRE(first > best);
+	REQUIRE(first <= 3 * best);
+
+	int last = first;
+	while (search.canImprove()) {
+		if (search.improve(64)) {
+			int improved = cost(search.result().second);
+			REQUIRE(improved < last);
+			last = improved;
+		}
+	}
+	REQUIRE(last == best);
+
+	//requests deliver the first path, then better ones under the same id while nothing else is queued
+	AI::pathRequests::setBudget(0);
+	AI::pathRequests::RequestId id = AI::pathRequests::request(start, goal, options, AI::pathRequests::Priority::SCOUTING);
+	std::vector<int> delivered;
+	for (int tick = 0; tick < 10000 && (delivered.empty() || delivered.back() > best); tick++) {
+		AI::pathRequests::update();
+		std::pair<bool, std::vector<glm::vec3>> result;
+		if (AI::pathRequests::takeResult(id, result)) {
+			REQUIRE(result.first);
+			delivered.push_back(cost(result.second));
+		}
+	}
+	REQUIRE(delivered.front() == first);
+	REQUIRE(delivered.back() == best);
+	REQUIRE(std::is_sorted(delivered.rbegin(), delivered.rend()));
+	AI::pathRequests::cancel(id);
+	AI::pathRequests::setBudget(AI::pathRequests::DEFAULT_BUDGET_MICROSECONDS);
+}
+
+TEST_CASE("Path requests show up on the next update unless cancelled", "[pathfinder]") {
+	loadCostMap({
+			"     ",
+			" ####",
+			"     ",
+	});
+	AI::pathRequests::init(2);
+	AI::aStar::PathOptions options;
+	AI::pathRequests::RequestId kept = AI::pathRequests::request({0, 0, 0}, {4, 0, 2}, options);
+	AI::pathRequests::RequestId cancelled = AI::pathRequests::request({0, 0, 0}, {4, 0, 0}, options);
+	AI::pathRequests::cancel(cancelled);
+
+	//cutting off the only way round after the request doesn't affect it, it searches the copy taken when it was made
+	Global::levelTraversalCostMap[2][2] = Config::OBSTACLE_COST;
+	AI::NavGrid::updateArea(2, 2, 2, 2);
+
+	std::pair<bool, std::vector<glm::vec3>> result;
+	REQUIRE(!AI::pathRequests::takeResult(kept, result)); //never on the same tick
+	while (AI::pathRequests::pendingCount() > 0 && !AI::pathRequests::takeResult(kept, result)) {
+		AI::pathRequests::update();
+	}
+	REQUIRE(result.first);
+	REQUIRE(result.second.back() == glm::vec3(4, 0, 2));
+	REQUIRE(!AI::pathRequests::takeResult(cancelled, result));
+	AI::pathRequests::shutdown();
+}
+
+TEST_CASE("Without workers requests are searched a bit at a time, most urgent first", "[pathfinder]") {
+	//winding back and forth, so even a well informed search needs more than one step
+	std::vector<std::string> rows(60, std::string(60, ' '));
+	for (int col = 10; col < 60; col += 10) {
+		for (int row = 0; row < 55; row++) {
+			rows[(col / 10) % 2 ? row : 59 - row][col] = '#';
+		}
+	}
+	loadCostMap(rows);
+	AI::aStar::PathOptions options;
+	AI::pathRequests::setBudget(0); //one step a tick
+	AI::pathRequests::RequestId scouting = AI::pathRequests::request({0, 0, 0}, {59, 0, 0}, options,
+																	 AI::pathRequests::Priority::SCOUTING);
+	AI::pathRequests::RequestId order = AI::pathRequests::request({0, 0, 0}, {59, 0, 0}, options,
+																  AI::pathRequests::Priority::PLAYER);
+	unsigned int suspended = AI::pathRequests::budgetStats().suspended;
+
+	std::pair<bool, std::vector<glm::vec3>> result;
+	int ticks = 0;
+	while (!AI::pathRequests::takeResult(order, result)) {
+		REQUIRE(!AI::pathRequests::takeResult(scouting, result));
+		AI::pathRequests::update();
+		ticks++;
+	}
+	REQUIRE(ticks > 1);
+	REQUIRE(AI::pathRequests::budgetStats().suspended > suspended);
+	REQUIRE(result == AI::aStar::findPath({0, 0, 0}, {59, 0, 0}, options));
+
+	while (AI::pathRequests::pendingCount() > 0 && !AI::pathRequests::takeResult(scouting, result)) {
+		AI::pathRequests::update();
+	}
+	REQUIRE(result.first);
+	AI::pathRequests::setBudget(AI::pathRequests::DEFAULT_BUDGET_MICROSECONDS);
+}